@@ -0,0 +1,27 @@
+#include "../ray-tracer/ray-tracing-scene.hpp"
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+int main(int argc, char ** argv)
+{
+    if(argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <scene filename> [compiled filename]" << std::endl;
+        return -1;
+    }
+    std::string filename(argv[1]);
+    std::string outfile = std::filesystem::path(filename).replace_extension(rt::RayTracingScene::COMPILED_EXTENSION).string();
+    if(argc >= 3)
+    {
+        outfile = std::string(argv[2]);
+    }
+
+    if(!rt::RayTracingScene::Compile(filename, outfile))
+    {
+        std::cerr << "Error compiling: " << filename << std::endl;
+        return -1;
+    }
+    std::cout << filename << " -> " << outfile << std::endl;
+    return 0;
+}
@@ -0,0 +1,35 @@
+#include "../ray-tracer/mesh.hpp"
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+int main(int argc, char ** argv)
+{
+    if(argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <obj filename> [mesh filename]" << std::endl;
+        return -1;
+    }
+    std::string filename(argv[1]);
+    std::string outfile = std::filesystem::path(filename).replace_extension(rt::TriangleMesh::BINARY_EXTENSION).string();
+    if(argc >= 3)
+    {
+        outfile = std::string(argv[2]);
+    }
+
+    rt::ThreadPool pool;
+    rt::TriangleMesh *mesh = rt::TriangleMesh::FromObj(filename, pool);
+    if(mesh == nullptr)
+    {
+        return -1;
+    }
+    if(!mesh->saveBinary(outfile))
+    {
+        std::cerr << "Error writing: " << outfile << std::endl;
+        delete mesh;
+        return -1;
+    }
+    std::cout << filename << " -> " << outfile << " (" << mesh->size() << " triangles)" << std::endl;
+    delete mesh;
+    return 0;
+}
\ No newline at end of file
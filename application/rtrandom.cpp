@@ -2,13 +2,13 @@
 
 #include <chrono>
 
-RTRandom::RTRandom(float rmin, float rmax):distribution(rmin, rmax)
-{
-    auto beginning = std::chrono::high_resolution_clock::now();
-    generator.seed(beginning.time_since_epoch().count());
-}
+RTRandom::RTRandom(float rmin, float rmax):RTRandom(rmin, rmax, std::chrono::high_resolution_clock::now().time_since_epoch().count())
+{}
+
+RTRandom::RTRandom(float rmin, float rmax, uint64_t seed):generator(seed), rmin(rmin), rmax(rmax)
+{}
 
 float RTRandom::get()
 {
-    return distribution(generator);
+    return generator.uniform(rmin, rmax);
 }
\ No newline at end of file
@@ -1,17 +1,19 @@
 #ifndef __RTRANDOM_H__
 #define __RTRANDOM_H__
 
-#include <random>
-#include <chrono>
+#include "../ray-tracer/random.hpp"
 
 class RTRandom
 {
 public:
+    // seeded from the clock, so every run differs.
     RTRandom(float rmin, float rmax);
+    // seeded explicitly, so a run can be repeated.
+    RTRandom(float rmin, float rmax, uint64_t seed);
     float get();
 private:
-    std::default_random_engine generator;
-    std::uniform_real_distribution<float> distribution;
+    rt::Random generator;
+    float rmin, rmax;
 };
 
 #endif // __RTRANDOM_H__
\ No newline at end of file
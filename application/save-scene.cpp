@@ -1,25 +1,90 @@
 #include "../ray-tracer/ray-tracer.hpp"
+#include "../ray-tracer/image-io.hpp"
 #include <opencv2/opencv.hpp>
 #include <string>
+#include <vector>
+
+static bool endsWith(const std::string &s, const std::string &suffix)
+{
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
 
 int main(int argc, char ** argv)
 {
-    if(argc < 2)
+    // flags may go anywhere, everything else is positional.
+    bool metric = false, depth16 = false;
+    std::vector<std::string> args;
+    for(int i = 1;i < argc;i++)
     {
-        std::cerr << "Usage: " << argv[0] << " <scene filename>" << std::endl;
+        std::string arg(argv[i]);
+        if(arg == "--metric")
+        {
+            metric = true;
+        }
+        else if(arg == "--16bit")
+        {
+            depth16 = true;
+        }
+        else
+        {
+            args.push_back(arg);
+        }
+    }
+    if(args.empty())
+    {
+        std::cerr << "Usage: " << argv[0] << " <scene filename> [outfile] [threads] [--metric] [--16bit]" << std::endl;
+        std::cerr << "  outfile ending in .pfm or .f32 keeps the full float distances," << std::endl;
+        std::cerr << "  --metric skips normalizing and writes the traced distances (.pfm or .f32 only)," << std::endl;
+        std::cerr << "  --16bit writes 16 bit instead of 8 bit images (.png)." << std::endl;
         return -1;
     }
     std::string outfile = "out.png";
-    if(argc >= 3)
+    if(args.size() >= 2)
     {
-        outfile = std::string(argv[2]);
+        outfile = args[1];
+    }
+    int threads = 0;
+    if(args.size() >= 3)
+    {
+        threads = std::stoi(args[2]);
+    }
+    std::string filename(args[0]);
+
+    bool lossless = endsWith(outfile, ".pfm") || endsWith(outfile, ".f32");
+    if(metric && !lossless)
+    {
+        std::cerr << "Metric distances need a .pfm or .f32 outfile: " << outfile << std::endl;
+        return -1;
     }
-    std::string filename(argv[1]);
 
-    cv::Mat im = trace_scene(filename, true);
-    
-    cv::Mat display;
-    im.convertTo(display, CV_8UC1, 255);
-    cv::imwrite(outfile, display);
+    cv::Mat im = trace_scene(filename, true, false, [](int,int){}, threads, !metric);
+
+    bool ok;
+    if(endsWith(outfile, ".pfm"))
+    {
+        ok = rt::writePFM(outfile, im.ptr<float>(), im.cols, im.rows);
+    }
+    else if(endsWith(outfile, ".f32"))
+    {
+        ok = rt::writeRaw(outfile, im.ptr<float>(), im.cols, im.rows);
+    }
+    else
+    {
+        cv::Mat display;
+        if(depth16)
+        {
+            im.convertTo(display, CV_16UC1, 65535);
+        }
+        else
+        {
+            im.convertTo(display, CV_8UC1, 255);
+        }
+        ok = cv::imwrite(outfile, display);
+    }
+    if(!ok)
+    {
+        std::cerr << "Error writing " << outfile << std::endl;
+        return -1;
+    }
     return 0;
 }
@@ -5,15 +5,16 @@
 
 int main(int argc, char ** argv)
 {
-	if(argc != 2)
+	if(argc != 2 && argc != 3)
 	{
-		std::cerr << "Usage: " << argv[0] << " <scene filename>" << std::endl;
+		std::cerr << "Usage: " << argv[0] << " <scene filename> [threads]" << std::endl;
 		return -1;
 	}
 	std::string filename(argv[1]);
+	int threads = argc == 3 ? std::stoi(argv[2]) : 0;
 
 	Timer timer;
-	cv::Mat im = trace_scene(filename, true);
+	cv::Mat im = trace_scene(filename, true, false, [](int,int){}, threads);
 	std::cout << "Traced in: " << timer << std::endl;
 	
 	cv::Mat display;
@@ -1,17 +1,19 @@
 #include <algorithm>
 #include <iostream>
-#include <fstream>
 #include <cmath>
+#include <cstring>
 #include <vector>
-#include <random>
 #include <functional>
 #include <chrono>
 #include <thread>
+#include <mutex>
+#include <memory>
 
-#define TINYOBJLOADER_IMPLEMENTATION
-#include "../include/tiny_obj_loader.h"
-
-std::default_random_engine gen;
+#include "../ray-tracer/thread-pool.hpp"
+#include "../ray-tracer/obj-loader.hpp"
+#include "../ray-tracer/random.hpp"
+#include "../ray-tracer/image-io.hpp"
+#include "../ray-tracer/scene-tokenizer.hpp"
 
 
 union vec3 {
@@ -28,29 +30,24 @@ struct SceneInfo {
     vec3 ambient;
     vec3 background;
     size_t samples;
+    size_t threads;
+    uint64_t seed;      // keys every random number of the render, so it can be repeated
 };
 
+// the side of the square image tiles handed to the threads.
+constexpr int TILE_SIZE = 16;
+// the number of bounces traced along a path, also the bounce index of the camera ray.
+constexpr int MAX_DEPTH = 5;
+
 struct mat4 {
     float data[4][4];
 };
 
 bool intersect(int &id, float &t);
-vec3 trace(const vec3 &ro, const vec3 &rd, int depth);
+vec3 trace(const vec3 &ro, const vec3 &rd, int depth, size_t pixel, size_t sample);
 std::string get_resources();
 bool raybox(const vec3 &ro, const vec3 &rd, vec3 bounds[2], float &t);
 
-std::istream &operator>>(std::istream &is, vec3 &v)
-{
-    is.ignore(256, '(');
-    is >> v.x;
-    is.ignore(256,',');
-    is >> v.y;
-    is.ignore(256,',');
-    is >> v.z;
-    is.ignore(256,')');
-    return is;
-}
-
 std::ostream &operator<<(std::ostream &os, const vec3 &v)
 {
     return os << "(" << v.x << "," << v.y << "," << v.z << ")";
@@ -490,14 +487,12 @@ public:
         shapes.push_back(shape);
     }
 
-    vec3 getDir(const vec3 &pt) const
+    vec3 getDir(const vec3 &pt, rt::Random &random) const
     {
-    //     std::uniform_real_distribution<float> fdist(0, 1);
-    // auto randf = std::bind(fdist, gen);
-        auto randx = std::bind(std::uniform_real_distribution<float>(emin.x, emax.x), gen);
-        auto randy = std::bind(std::uniform_real_distribution<float>(emin.y, emax.y), gen);
-        auto randz = std::bind(std::uniform_real_distribution<float>(emin.z, emax.z), gen);
-        vec3 objpt = vec3(randx(), randy(), randz());
+        float x = random.uniform(emin.x, emax.x);
+        float y = random.uniform(emin.y, emax.y);
+        float z = random.uniform(emin.z, emax.z);
+        vec3 objpt = vec3(x, y, z);
         return norm(objpt - pt);
         // vec3 dir;
         // for(size_t i = 0;i < shapes.size();i++)
@@ -508,50 +503,28 @@ public:
         // return dir;
     }
 
-    void addObj(const std::string &filename, const vec3 &tran, const vec3 &rota, const vec3 &scal)
+    void addObj(const std::string &filename, const vec3 &tran, const vec3 &rota, const vec3 &scal, rt::ThreadPool &pool)
     {
-        tinyobj::attrib_t attrib;
-        std::vector<tinyobj::shape_t> objshapes;
-        std::vector<tinyobj::material_t> materials;
-        std::string warn, err;
-        bool ret = tinyobj::LoadObj(&attrib, &objshapes, &materials, &warn, &err, filename.c_str());
-        if(!warn.empty())
-        {
-            std::cout << warn << std::endl;
-        }
-
-        if(!err.empty())
-        {
-            std::cerr << err << std::endl;
-        }
-
-        if(!ret)
+        std::vector<rt::vec3> vertices;
+        std::vector<uint32_t> faces;
+        if(!rt::loadObj(filename, vertices, faces, pool))
         {
             return;
-        }  
+        }
 
         mat4 t = translation(tran);
         mat4 s = scaling(scal);
         mat4 r = rotation(rota);
         mat4 m = matmul(t, matmul(s, r));
-        for(size_t s = 0; s < objshapes.size();s++)
+        for(size_t f = 0;f < faces.size();f += 3)
         {
-            size_t index_offset = 0;
-            for(size_t f = 0;f < objshapes[s].mesh.num_face_vertices.size();f++)
+            vec3 verts[3];
+            for(size_t v = 0;v < 3;v++)
             {
-                size_t fv = objshapes[s].mesh.num_face_vertices[f];
-                vec3 verts[3];
-                for(size_t v = 0;v < fv;v++)
-                {
-                    tinyobj::index_t idx = objshapes[s].mesh.indices[index_offset + v];
-                    tinyobj::real_t x = attrib.vertices[3 * idx.vertex_index + 0];
-                    tinyobj::real_t y = attrib.vertices[3 * idx.vertex_index + 1];
-                    tinyobj::real_t z = attrib.vertices[3 * idx.vertex_index + 2];
-                    verts[v] = transformPt(m, vec3(x, y, z));
-                }
-                addShape(new Triangle(verts[0], verts[1], verts[2]));
-                index_offset += fv;
+                const rt::vec3 &vertex = vertices[faces[f + v]];
+                verts[v] = transformPt(m, vec3(vertex.x, vertex.y, vertex.z));
             }
+            addShape(new Triangle(verts[0], verts[1], verts[2]));
         }
     }
 private:
@@ -626,7 +599,7 @@ void fresnel(const vec3 &I, const vec3 &N, const float &ior, float &kr)
     }
 }
 
-vec3 trace(const vec3 &ro, const vec3 &rd, int depth)
+vec3 trace(const vec3 &ro, const vec3 &rd, int depth, size_t pixel, size_t sample)
 {
     vec3 pt, n;
     Material mat;
@@ -645,7 +618,7 @@ vec3 trace(const vec3 &ro, const vec3 &rd, int depth)
     if(mat.type == REFL)
     {
         vec3 dir = norm(reflect(rd, n)); 
-        kd = trace(pt + dir * 1e-4, dir, depth);
+        kd = trace(pt + dir * 1e-4, dir, depth, pixel, sample);
     }
     else if(mat.type == REFR)
     {
@@ -656,7 +629,7 @@ vec3 trace(const vec3 &ro, const vec3 &rd, int depth)
         }
         else 
         {
-            kd = trace(pt + dir * 1e-4, dir, depth);
+            kd = trace(pt + dir * 1e-4, dir, depth, pixel, sample);
         }
     }
     else if(mat.type == FRES)
@@ -671,11 +644,11 @@ vec3 trace(const vec3 &ro, const vec3 &rd, int depth)
         {
             vec3 refrdir = refract(rd, n, mat.ior);
             vec3 refrpt = outside ? pt - bias : pt + bias;
-            refrc = trace(refrpt, refrdir, depth);
+            refrc = trace(refrpt, refrdir, depth, pixel, sample);
         }
         vec3 refldir = norm(reflect(rd, n));
         vec3 reflpt = outside ? pt + bias : pt - bias;
-        vec3 reflc = trace(reflpt, refldir, depth);
+        vec3 reflc = trace(reflpt, refldir, depth, pixel, sample);
 
         kd  = reflc * kr + refrc * (1 - kr);
     }
@@ -687,6 +660,7 @@ vec3 trace(const vec3 &ro, const vec3 &rd, int depth)
     vec3 v = -norm(rd);
     n = norm(n);
     vec3 finalColor;
+    rt::Random random(options.seed, pixel, sample, depth);
     vec3 colours[objects.size()];
     bool hits[objects.size()];
     memset(hits, 0, sizeof(bool) * objects.size());
@@ -696,7 +670,7 @@ vec3 trace(const vec3 &ro, const vec3 &rd, int depth)
         for(size_t i = 0;i < objects.size();i++)
         {
             Material objmat = objects[i].getcolor();
-            vec3 objdir = objects[i].getDir(pt);
+            vec3 objdir = objects[i].getDir(pt, random);
             int objid;
             vec3 objpt, objn;
             if(objmat.type != LIGHT || !intersect(pt+objdir*1e-4, objdir, objid, objmat, objpt, objn) || objid != (int)i) 
@@ -728,8 +702,8 @@ void addShape(const Material &mat, Shape *shape)
 
 void initObjects()
 {
-    std::uniform_real_distribution<float> fdist(0, 1);
-    auto randf = std::bind(fdist, gen);
+    rt::Random random(options.seed);
+    auto randf = [&]{return random.uniform();};
 
     addShape(Material(vec3(randf(), randf(), randf()),vec3(randf(), randf(), randf()), vec3(randf(), randf(), randf()), randf() * 128, randf() + 0.5, (ReflType)(randf() * 5)), new Sphere(vec3(0, 0, 0), 0.2));
     addShape(Material(vec3(1, 1, 1), vec3(1,1,1), vec3(1,1,1), 32, 1.03, LIGHT), new Sphere(vec3(0.0, 0.75, -0.5), 0.05));
@@ -744,14 +718,14 @@ std::string get_resources()
     return result;
 }
 
-int loadScene(const std::string &filename, SceneInfo &options, std::vector<Object> &objects)
+int loadScene(const std::string &filename, SceneInfo &options, std::vector<Object> &objects, rt::ThreadPool &pool)
 {
-    std::uniform_real_distribution<float> fdist(0, 1);
-    auto randf = std::bind(fdist, gen);
+    rt::Random random(options.seed);
+    auto randf = [&]{return random.uniform();};
 
 
-    std::ifstream f(filename);
-    if(!f.is_open())
+    rt::SceneTokenizer f;
+    if(!f.open(filename))
     {
        return -1;
     }
@@ -761,10 +735,10 @@ int loadScene(const std::string &filename, SceneInfo &options, std::vector<Objec
     options.background = vec3(randf(), randf(), randf());
     options.ambient = vec3(randf(), randf(), randf());
     options.samples = 16;
+    options.threads = 0;
     std::string token;
-    while(f >> token)
+    while(f.label(token))
     {
-        std::transform(token.begin(), token.end(), token.begin(), [](unsigned char c){return std::tolower(c);});
         ReflType type = (ReflType)(randf() * 5);
         // ReflType type = DIFF;
 
@@ -805,6 +779,12 @@ int loadScene(const std::string &filename, SceneInfo &options, std::vector<Objec
             f >> samples;
             options.samples = samples;
         }
+        else if(token == "threads")
+        {
+            size_t threads;
+            f >> threads;
+            options.threads = threads;
+        }
         else if(token == "sphere")
         {
             vec3 center;
@@ -827,7 +807,7 @@ int loadScene(const std::string &filename, SceneInfo &options, std::vector<Objec
             f >> filename >> t >> r >> s;
             r = vec3(radians(r.x), radians(r.y), radians(r.z));
             std::string path = get_resources() + "/objs/" + filename;
-            obj.addObj(path, t, r, s);
+            obj.addObj(path, t, r, s, pool);
             objects.push_back(obj);
         }
     }
@@ -849,94 +829,101 @@ int loadScene(const std::string &filename, SceneInfo &options, std::vector<Objec
 }
 
 
-vec3 *colors;
-
-vec3 distributed_threaded_method(const vec3 &eye, float x, float y, float px, float py)
+vec3 distributed_single_method(const vec3 &eye, float x, float y, float px, float py, size_t pixel)
 {
-    std::uniform_real_distribution<float> fdist(-1, 1);
-    auto randf = std::bind(fdist, gen);
-    std::vector<std::thread> threads;
-    for(size_t k = 0;k < options.samples;k++)
-    {
-        float dx = x + randf() * px;
-        float dy = y + randf() * py;
-        vec3 dir = norm(vec3(dx, dy, 1));
-        threads.push_back(std::thread([&](vec3 eye, vec3 dir, size_t k){
-            colors[k] = trace(eye, dir, 5);
-        }, eye, dir, k));
-    }
-
-    vec3 color;
-    for(size_t k = 0;k < options.samples;k++)
-    {
-        threads[k].join();
-        color = color + colors[k] / static_cast<float>(options.samples);
-    }
-    return color;
-}
-
-vec3 distributed_single_method(const vec3 &eye, float x, float y, float px, float py)
-{
-    std::uniform_real_distribution<float> fdist(-1, 1);
-    auto randf = std::bind(fdist, gen);
     vec3 color;
     for(size_t i = 0;i < options.samples;i++)
     {
-        float dx = x + randf() * px;
-        float dy = y + randf() * py;
+        rt::Random random(options.seed, pixel, i, MAX_DEPTH);
+        float dx = x + random.uniform(-1, 1) * px;
+        float dy = y + random.uniform(-1, 1) * py;
         vec3 dir = norm(vec3(dx, dy, 1));
-        color = color + trace(eye, dir, 5) / static_cast<float>(options.samples);
+        color = color + trace(eye, dir, MAX_DEPTH, pixel, i) / static_cast<float>(options.samples);
     }
     return color;
 }
 
-vec3 single_method(const vec3 &eye, float x, float y)
+vec3 single_method(const vec3 &eye, float x, float y, size_t pixel)
 {
     vec3 dir = norm(vec3(x, y, 1));
-    return trace(eye, dir, 5);
+    return trace(eye, dir, MAX_DEPTH, pixel, 0);
 }
 
 int main(int argc, char ** argv)
 {
-    gen.seed(std::chrono::high_resolution_clock::now().time_since_epoch().count());
+    options.seed = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    if(argc >= 4)
+    {
+        options.seed = std::stoull(argv[3]);
+    }
+    std::cerr << "Seed: " << options.seed << std::endl;
 
     std::string scenename = get_resources() + "/scenes/basic.scene";
     if(argc >= 2)
     {
         scenename = std::string(argv[1]);
     }
-    if(loadScene(scenename, options, objects) == -1)
+    // obj files are loaded on every hardware thread, the image is rendered on the threads asked for.
+    std::unique_ptr<rt::ThreadPool> pool(new rt::ThreadPool());
+    if(loadScene(scenename, options, objects, *pool) == -1)
     {
         perror(scenename.c_str());
         return -1;
     }
 
+    if(argc >= 3)
+    {
+        options.threads = std::stoul(argv[2]);
+    }
+
     float w = options.width, h = options.height;
     float pix_sizex = 1 / w;
     float pix_sizey = 1 / h;
     float scale = atan(radians(options.fov) * 0.5f);
     float aspect = w/h;
 
-    colors = new vec3[options.samples];
-
-    
-    std::ofstream f("out.ppm");
-    f << "P3\n" << options.width << " " << options.height << "\n255\n";
-    
+    // every tile runs all the samples of its pixels, and writes them straight into the image.
+    std::vector<vec3> image(options.width * options.height);
+    int tilesX = (options.width + TILE_SIZE - 1) / TILE_SIZE;
+    int tilesY = (options.height + TILE_SIZE - 1) / TILE_SIZE;
+    int tiles = tilesX * tilesY;
+    std::mutex progress;
+    int finished = 0;
     vec3 eye(0, 0, -3);
-    for(int i = 0;i < options.height;i++)
+    if(options.threads > 0 && pool->size() != options.threads)
     {
-        std::cerr << " Rows: " << i << "/" << options.height << "     \r" << std::flush;
-        for(int j = 0;j < options.width;j++)
+        pool.reset(new rt::ThreadPool(options.threads));
+    }
+    pool->parallelFor(tiles, [&](size_t tile)
+    {
+        int j0 = tile % tilesX * TILE_SIZE, i0 = tile / tilesX * TILE_SIZE;
+        int j1 = std::min(j0 + TILE_SIZE, options.width), i1 = std::min(i0 + TILE_SIZE, options.height);
+        for(int i = i0;i < i1;i++)
         {
-            float x = (2.0f * (((j + 0.5f) / w) - 0.5f)) * scale * aspect;
-            float y = (2.0f * (0.5f - ((i + 0.5f) / h))) * scale;
-            vec3 color = distributed_single_method(eye, x, y, pix_sizex, pix_sizey);
-            
-            f << scaleValue(color.x) << " " << scaleValue(color.y) << " " << scaleValue(color.z) << " ";
+            for(int j = j0;j < j1;j++)
+            {
+                float x = (2.0f * (((j + 0.5f) / w) - 0.5f)) * scale * aspect;
+                float y = (2.0f * (0.5f - ((i + 0.5f) / h))) * scale;
+                size_t pixel = i * options.width + j;
+                image[pixel] = distributed_single_method(eye, x, y, pix_sizex, pix_sizey, pixel);
+            }
         }
-    }
+        std::lock_guard<std::mutex> guard(progress);
+        std::cerr << " Tiles: " << ++finished << "/" << tiles << "     \r" << std::flush;
+    });
     std::cerr << std::endl;
-    delete [] colors;
+
+    std::vector<unsigned char> rgb(3 * image.size());
+    for(size_t i = 0;i < image.size();i++)
+    {
+        rgb[3 * i] = scaleValue(image[i].x);
+        rgb[3 * i + 1] = scaleValue(image[i].y);
+        rgb[3 * i + 2] = scaleValue(image[i].z);
+    }
+    if(!rt::writePPM("out.ppm", rgb.data(), options.width, options.height))
+    {
+        std::cerr << "Error writing out.ppm" << std::endl;
+        return 1;
+    }
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,1037 @@
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <thread>
+
+namespace rt
+{
+    constexpr size_t BVH::MAX_LEAF_SIZE;
+    constexpr size_t BVH::SAH_BUCKETS;
+    constexpr size_t BVH::MAX_DEPTH;
+    constexpr float BVH::DEFAULT_SPLIT_BUDGET;
+    constexpr float BVH::SPLIT_OVERLAP;
+    constexpr float BVH::REFIT_THRESHOLD;
+    constexpr uint32_t BVH::PADDING;
+
+    static float axisOf(const vec3 &v, const int &axis)
+    {
+        return axis == 0 ? v.x : axis == 1 ? v.y : v.z;
+    }
+
+    static float &axisOf(vec3 &v, const int &axis)
+    {
+        return axis == 0 ? v.x : axis == 1 ? v.y : v.z;
+    }
+
+    static void emptyBox(vec3 bounds[2])
+    {
+        float big = std::numeric_limits<float>::max();
+        bounds[0] = {big, big, big};
+        bounds[1] = {-big, -big, -big};
+    }
+
+    static void growBox(vec3 bounds[2], const vec3 &emin, const vec3 &emax)
+    {
+        bounds[0] = {std::min(bounds[0].x, emin.x), std::min(bounds[0].y, emin.y), std::min(bounds[0].z, emin.z)};
+        bounds[1] = {std::max(bounds[1].x, emax.x), std::max(bounds[1].y, emax.y), std::max(bounds[1].z, emax.z)};
+    }
+
+    static float surfaceArea(const vec3 bounds[2])
+    {
+        vec3 d = bounds[1] - bounds[0];
+        if(d.x < 0 || d.y < 0 || d.z < 0) return 0;
+        return 2 * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    void BVH::build(const std::vector<BVHPrimitive> &prims, const BuildMode &mode, const BVHClip &clip, const float &budget, const size_t &leafSize)
+    {
+        clear();
+        this->leafSize = std::max<size_t>(1, leafSize);
+        if(prims.empty()) return;
+        if(mode == MORTON)
+        {
+            buildMorton(prims);
+        }
+        else if(mode == SPATIAL)
+        {
+            buildSpatial(prims, clip, budget);
+        }
+        else
+        {
+            indices.resize(prims.size());
+            for(size_t i = 0;i < prims.size();i++)
+            {
+                indices[i] = i;
+            }
+            nodes.reserve(2 * prims.size());
+            buildRecursive(prims, 0, prims.size(), 0);
+            nodes.shrink_to_fit();
+        }
+        collapse();
+        builtCost = cost();
+    }
+
+    uint32_t BVH::buildRecursive(const std::vector<BVHPrimitive> &prims, size_t start, size_t end, size_t depth)
+    {
+        uint32_t index = nodes.size();
+        nodes.push_back(BVHNode());
+
+        vec3 bounds[2], cbounds[2];
+        emptyBox(bounds);
+        emptyBox(cbounds);
+        for(size_t i = start;i < end;i++)
+        {
+            const BVHPrimitive &p = prims[indices[i]];
+            growBox(bounds, p.bounds[0], p.bounds[1]);
+            growBox(cbounds, p.centroid, p.centroid);
+        }
+        nodes[index].bounds[0] = bounds[0];
+        nodes[index].bounds[1] = bounds[1];
+
+        size_t count = end - start;
+        vec3 extent = cbounds[1] - cbounds[0];
+        int axis = extent.x > extent.y && extent.x > extent.z ? 0 : extent.y > extent.z ? 1 : 2;
+        float cmin = axisOf(cbounds[0], axis);
+        float cextent = axisOf(extent, axis);
+
+        if(count == 1 || (count <= leafSize && cextent <= 0))
+        {
+            nodes[index].offset = start;
+            nodes[index].count = count;
+            nodes[index].axis = 0;
+            return index;
+        }
+
+        size_t mid = start;
+        if(cextent > 0 && depth < MAX_DEPTH)
+        {
+            // bin the centroids and evaluate the surface area heuristic at every bucket boundary.
+            size_t counts[SAH_BUCKETS] = {0};
+            vec3 bbounds[SAH_BUCKETS][2];
+            for(size_t b = 0;b < SAH_BUCKETS;b++)
+            {
+                emptyBox(bbounds[b]);
+            }
+            auto bucketOf = [&](const BVHPrimitive &p)
+            {
+                size_t b = SAH_BUCKETS * ((axisOf(p.centroid, axis) - cmin) / cextent);
+                return std::min(b, SAH_BUCKETS - 1);
+            };
+            for(size_t i = start;i < end;i++)
+            {
+                const BVHPrimitive &p = prims[indices[i]];
+                size_t b = bucketOf(p);
+                counts[b]++;
+                growBox(bbounds[b], p.bounds[0], p.bounds[1]);
+            }
+
+            // sweep from the right to get the area of every suffix, then from the left.
+            float rightArea[SAH_BUCKETS];
+            size_t rightCount[SAH_BUCKETS];
+            vec3 acc[2];
+            emptyBox(acc);
+            size_t n = 0;
+            for(size_t b = SAH_BUCKETS - 1;b > 0;b--)
+            {
+                growBox(acc, bbounds[b][0], bbounds[b][1]);
+                n += counts[b];
+                rightArea[b] = surfaceArea(acc);
+                rightCount[b] = n;
+            }
+            float area = surfaceArea(bounds);
+            float bestCost = std::numeric_limits<float>::max();
+            size_t bestSplit = 0;
+            emptyBox(acc);
+            n = 0;
+            for(size_t b = 0;b < SAH_BUCKETS - 1;b++)
+            {
+                growBox(acc, bbounds[b][0], bbounds[b][1]);
+                n += counts[b];
+                float cost = 1 + (n * surfaceArea(acc) + rightCount[b + 1] * rightArea[b + 1]) / area;
+                if(cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestSplit = b;
+                }
+            }
+
+            if(count <= leafSize && bestCost >= count)
+            {
+                nodes[index].offset = start;
+                nodes[index].count = count;
+                nodes[index].axis = 0;
+                return index;
+            }
+
+            mid = std::partition(indices.begin() + start, indices.begin() + end, [&](const uint32_t &i)
+            {
+                return bucketOf(prims[i]) <= bestSplit;
+            }) - indices.begin();
+        }
+
+        if(mid == start || mid == end)
+        {
+            // no useful split was found, fall back to splitting at the median centroid.
+            mid = (start + end) / 2;
+            std::nth_element(indices.begin() + start, indices.begin() + mid, indices.begin() + end, [&](const uint32_t &a, const uint32_t &b)
+            {
+                return axisOf(prims[a].centroid, axis) < axisOf(prims[b].centroid, axis);
+            });
+        }
+
+        buildRecursive(prims, start, mid, depth + 1);
+        uint32_t second = buildRecursive(prims, mid, end, depth + 1);
+        nodes[index].offset = second;
+        nodes[index].count = 0;
+        nodes[index].axis = axis;
+        return index;
+    }
+
+    // below this many primitives per thread the work is not worth spawning threads for.
+    static constexpr size_t MIN_PARALLEL_SIZE = 1 << 14;
+
+    static size_t threadCount(const size_t &n)
+    {
+        size_t threads = std::max(1u, std::thread::hardware_concurrency());
+        return std::max<size_t>(1, std::min(threads, n / MIN_PARALLEL_SIZE));
+    }
+
+    /**
+     * parallelChunks:
+     * ---------------
+     * splits [0, n) into chunks contiguous ranges and calls f(chunk, begin, end)
+     * for each of them on its own thread.
+     */
+    template<typename F>
+    static void parallelChunks(const size_t &n, const size_t &chunks, F f)
+    {
+        std::vector<std::thread> threads;
+        for(size_t c = 1;c < chunks;c++)
+        {
+            threads.push_back(std::thread(f, c, n * c / chunks, n * (c + 1) / chunks));
+        }
+        f(0, 0, n / chunks);
+        for(auto &thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    /**
+     * expandBits:
+     * -----------
+     * spreads the lower 10 bits of v so there are two zero bits between each of them.
+     */
+    static uint32_t expandBits(uint32_t v)
+    {
+        v = (v * 0x00010001u) & 0xFF0000FFu;
+        v = (v * 0x00000101u) & 0x0F00F00Fu;
+        v = (v * 0x00000011u) & 0xC30C30C3u;
+        v = (v * 0x00000005u) & 0x49249249u;
+        return v;
+    }
+
+    /**
+     * radixSort:
+     * ----------
+     * a parallel least significant digit radix sort of 30 bit keys, carrying values along.
+     */
+    static void radixSort(std::vector<uint32_t> &keys, std::vector<uint32_t> &values)
+    {
+        constexpr size_t BITS = 8, DIGITS = 1 << BITS;
+        size_t n = keys.size();
+        size_t chunks = threadCount(n);
+        std::vector<uint32_t> keys2(n), values2(n);
+        std::vector<size_t> offsets(chunks * DIGITS);
+        for(size_t shift = 0;shift < 32;shift += BITS)
+        {
+            std::fill(offsets.begin(), offsets.end(), 0);
+            parallelChunks(n, chunks, [&](size_t c, size_t begin, size_t end)
+            {
+                size_t *hist = &offsets[c * DIGITS];
+                for(size_t i = begin;i < end;i++)
+                {
+                    hist[(keys[i] >> shift) & (DIGITS - 1)]++;
+                }
+            });
+            // turn the per chunk histograms into scatter offsets, digit major so the sort stays stable.
+            size_t sum = 0;
+            for(size_t d = 0;d < DIGITS;d++)
+            {
+                for(size_t c = 0;c < chunks;c++)
+                {
+                    size_t count = offsets[c * DIGITS + d];
+                    offsets[c * DIGITS + d] = sum;
+                    sum += count;
+                }
+            }
+            parallelChunks(n, chunks, [&](size_t c, size_t begin, size_t end)
+            {
+                size_t *offset = &offsets[c * DIGITS];
+                for(size_t i = begin;i < end;i++)
+                {
+                    size_t dst = offset[(keys[i] >> shift) & (DIGITS - 1)]++;
+                    keys2[dst] = keys[i];
+                    values2[dst] = values[i];
+                }
+            });
+            keys.swap(keys2);
+            values.swap(values2);
+        }
+    }
+
+    /**
+     * emitMorton:
+     * -----------
+     * emits the subtree over the sorted range [start, end) depth first into out,
+     * splitting at the highest bit where the Morton codes of the range differ.
+     * The first spawn levels build their second subtree on another thread.
+     */
+    static void emitMorton(const std::vector<BVHPrimitive> &prims, const std::vector<uint32_t> &codes, const std::vector<uint32_t> &indices, size_t start, size_t end, size_t spawn, const size_t &leafSize, std::vector<BVHNode> &out)
+    {
+        uint32_t index = out.size();
+        out.push_back(BVHNode());
+        if(end - start <= leafSize)
+        {
+            vec3 bounds[2];
+            emptyBox(bounds);
+            for(size_t i = start;i < end;i++)
+            {
+                growBox(bounds, prims[indices[i]].bounds[0], prims[indices[i]].bounds[1]);
+            }
+            out[index].bounds[0] = bounds[0];
+            out[index].bounds[1] = bounds[1];
+            out[index].offset = start;
+            out[index].count = end - start;
+            out[index].axis = 0;
+            return;
+        }
+
+        size_t mid;
+        int axis = 0;
+        uint32_t diff = codes[start] ^ codes[end - 1];
+        if(diff == 0)
+        {
+            // every code in the range is the same, split it in half.
+            mid = (start + end) / 2;
+        }
+        else
+        {
+            int bit = 31 - __builtin_clz(diff);
+            axis = 2 - bit % 3;
+            mid = std::partition_point(codes.begin() + start, codes.begin() + end, [bit](const uint32_t &code)
+            {
+                return ((code >> bit) & 1) == 0;
+            }) - codes.begin();
+        }
+
+        uint32_t second;
+        if(spawn > 0)
+        {
+            std::vector<BVHNode> right;
+            std::thread thread([&]()
+            {
+                emitMorton(prims, codes, indices, mid, end, spawn - 1, leafSize, right);
+            });
+            emitMorton(prims, codes, indices, start, mid, spawn - 1, leafSize, out);
+            thread.join();
+            second = out.size();
+            for(auto node : right)
+            {
+                if(node.count == 0)
+                {
+                    node.offset += second;
+                }
+                out.push_back(node);
+            }
+        }
+        else
+        {
+            emitMorton(prims, codes, indices, start, mid, 0, leafSize, out);
+            second = out.size();
+            emitMorton(prims, codes, indices, mid, end, 0, leafSize, out);
+        }
+
+        vec3 bounds[2] = {out[index + 1].bounds[0], out[index + 1].bounds[1]};
+        growBox(bounds, out[second].bounds[0], out[second].bounds[1]);
+        out[index].bounds[0] = bounds[0];
+        out[index].bounds[1] = bounds[1];
+        out[index].offset = second;
+        out[index].count = 0;
+        out[index].axis = axis;
+    }
+
+    void BVH::buildMorton(const std::vector<BVHPrimitive> &prims)
+    {
+        size_t n = prims.size();
+        size_t chunks = threadCount(n);
+
+        std::vector<vec3> cbounds(2 * chunks);
+        parallelChunks(n, chunks, [&](size_t c, size_t begin, size_t end)
+        {
+            emptyBox(&cbounds[2 * c]);
+            for(size_t i = begin;i < end;i++)
+            {
+                growBox(&cbounds[2 * c], prims[i].centroid, prims[i].centroid);
+            }
+        });
+        vec3 bounds[2];
+        emptyBox(bounds);
+        for(size_t c = 0;c < chunks;c++)
+        {
+            growBox(bounds, cbounds[2 * c], cbounds[2 * c + 1]);
+        }
+        vec3 extent = bounds[1] - bounds[0];
+        vec3 scale = {extent.x > 0 ? 1023 / extent.x : 0, extent.y > 0 ? 1023 / extent.y : 0, extent.z > 0 ? 1023 / extent.z : 0};
+
+        std::vector<uint32_t> codes(n);
+        indices.resize(n);
+        parallelChunks(n, chunks, [&](size_t, size_t begin, size_t end)
+        {
+            for(size_t i = begin;i < end;i++)
+            {
+                vec3 p = prims[i].centroid - bounds[0];
+                uint32_t x = p.x * scale.x, y = p.y * scale.y, z = p.z * scale.z;
+                codes[i] = (expandBits(x) << 2) | (expandBits(y) << 1) | expandBits(z);
+                indices[i] = i;
+            }
+        });
+        radixSort(codes, indices);
+
+        // spawn a thread per subtree for the first few levels.
+        size_t spawn = 0;
+        while((size_t(1) << spawn) < chunks)
+        {
+            spawn++;
+        }
+        nodes.reserve(2 * n / leafSize + 1);
+        emitMorton(prims, codes, indices, 0, n, spawn, leafSize, nodes);
+    }
+
+    /**
+     * BVHReference:
+     * -------------
+     * a reference to a primitive during a spatial build.  Once a primitive has
+     * been split its references only cover the part of it on their own side.
+     */
+    struct BVHReference
+    {
+        vec3 bounds[2];
+        uint32_t index;
+    };
+
+    /**
+     * SpatialBuild:
+     * -------------
+     * the state shared by every node of a spatial build.
+     */
+    struct SpatialBuild
+    {
+        const BVHClip &clip;
+        size_t budget;          // references that may still be added by splitting
+        size_t leafSize;
+        float rootArea;
+        std::vector<BVHNode> &nodes;
+        std::vector<uint32_t> &indices;
+    };
+
+    static vec3 centroidOf(const BVHReference &ref)
+    {
+        return (ref.bounds[0] + ref.bounds[1]) / 2;
+    }
+
+    /**
+     * clipReference:
+     * --------------
+     * the bounds of the part of a reference lying in the slab lo <= p[axis] <= hi.
+     */
+    static void clipReference(const SpatialBuild &b, const BVHReference &ref, const int &axis, const float &lo, const float &hi, vec3 bounds[2])
+    {
+        bounds[0] = ref.bounds[0];
+        bounds[1] = ref.bounds[1];
+        if(b.clip)
+        {
+            vec3 clipped[2];
+            b.clip(ref.index, axis, lo, hi, clipped);
+            vec3 out[2] = {
+                {std::max(clipped[0].x, bounds[0].x), std::max(clipped[0].y, bounds[0].y), std::max(clipped[0].z, bounds[0].z)},
+                {std::min(clipped[1].x, bounds[1].x), std::min(clipped[1].y, bounds[1].y), std::min(clipped[1].z, bounds[1].z)}
+            };
+            // rounding can leave the clipped part empty, in which case keep the box instead.
+            if(out[0].x <= out[1].x && out[0].y <= out[1].y && out[0].z <= out[1].z)
+            {
+                bounds[0] = out[0];
+                bounds[1] = out[1];
+            }
+        }
+        axisOf(bounds[0], axis) = std::max(axisOf(bounds[0], axis), lo);
+        axisOf(bounds[1], axis) = std::min(axisOf(bounds[1], axis), hi);
+    }
+
+    /**
+     * emitSpatial:
+     * ------------
+     * emits the subtree over refs depth first, choosing at every node between
+     * the best binned object split and the best binned spatial split.  Spatial
+     * splits copy the references straddling the plane into both children.
+     */
+    static uint32_t emitSpatial(SpatialBuild &b, std::vector<BVHReference> &refs, size_t depth)
+    {
+        uint32_t index = b.nodes.size();
+        b.nodes.push_back(BVHNode());
+
+        vec3 bounds[2], cbounds[2];
+        emptyBox(bounds);
+        emptyBox(cbounds);
+        for(const auto &ref : refs)
+        {
+            vec3 c = centroidOf(ref);
+            growBox(bounds, ref.bounds[0], ref.bounds[1]);
+            growBox(cbounds, c, c);
+        }
+        b.nodes[index].bounds[0] = bounds[0];
+        b.nodes[index].bounds[1] = bounds[1];
+
+        size_t count = refs.size();
+        vec3 extent = cbounds[1] - cbounds[0];
+        int axis = extent.x > extent.y && extent.x > extent.z ? 0 : extent.y > extent.z ? 1 : 2;
+        float cmin = axisOf(cbounds[0], axis);
+        float cextent = axisOf(extent, axis);
+
+        auto makeLeaf = [&]()
+        {
+            b.nodes[index].offset = b.indices.size();
+            b.nodes[index].count = count;
+            b.nodes[index].axis = 0;
+            for(const auto &ref : refs)
+            {
+                b.indices.push_back(ref.index);
+            }
+            return index;
+        };
+
+        if(count == 1 || (count <= b.leafSize && cextent <= 0))
+        {
+            return makeLeaf();
+        }
+
+        constexpr size_t BINS = BVH::SAH_BUCKETS;
+        float area = surfaceArea(bounds);
+        std::vector<BVHReference> left, right;
+
+        // the object split, binned on centroids exactly like the SAH builder.
+        float objectCost = std::numeric_limits<float>::max();
+        size_t objectSplit = 0;
+        vec3 objectBoxes[2][2];
+        emptyBox(objectBoxes[0]);
+        emptyBox(objectBoxes[1]);
+        auto bucketOf = [&](const BVHReference &ref)
+        {
+            size_t bucket = BINS * ((axisOf(centroidOf(ref), axis) - cmin) / cextent);
+            return std::min(bucket, BINS - 1);
+        };
+        if(cextent > 0 && depth < BVH::MAX_DEPTH)
+        {
+            size_t counts[BINS] = {0};
+            vec3 bbounds[BINS][2];
+            for(size_t i = 0;i < BINS;i++)
+            {
+                emptyBox(bbounds[i]);
+            }
+            for(const auto &ref : refs)
+            {
+                size_t i = bucketOf(ref);
+                counts[i]++;
+                growBox(bbounds[i], ref.bounds[0], ref.bounds[1]);
+            }
+            vec3 rightBox[BINS][2];
+            size_t rightCount[BINS];
+            vec3 acc[2];
+            emptyBox(acc);
+            size_t n = 0;
+            for(size_t i = BINS - 1;i > 0;i--)
+            {
+                growBox(acc, bbounds[i][0], bbounds[i][1]);
+                n += counts[i];
+                rightBox[i][0] = acc[0];
+                rightBox[i][1] = acc[1];
+                rightCount[i] = n;
+            }
+            emptyBox(acc);
+            n = 0;
+            for(size_t i = 0;i < BINS - 1;i++)
+            {
+                growBox(acc, bbounds[i][0], bbounds[i][1]);
+                n += counts[i];
+                float cost = 1 + (n * surfaceArea(acc) + rightCount[i + 1] * surfaceArea(rightBox[i + 1])) / area;
+                if(cost < objectCost)
+                {
+                    objectCost = cost;
+                    objectSplit = i;
+                    objectBoxes[0][0] = acc[0];
+                    objectBoxes[0][1] = acc[1];
+                    objectBoxes[1][0] = rightBox[i + 1][0];
+                    objectBoxes[1][1] = rightBox[i + 1][1];
+                }
+            }
+        }
+
+        // the spatial split, only worth trying when the object split children overlap.
+        float spatialCost = std::numeric_limits<float>::max();
+        int spatialAxis = 0;
+        float spatialPlane = 0;
+        if(b.budget > 0 && depth < BVH::MAX_DEPTH)
+        {
+            float overlap = std::numeric_limits<float>::max();
+            if(objectCost < std::numeric_limits<float>::max())
+            {
+                vec3 o[2] = {
+                    {std::max(objectBoxes[0][0].x, objectBoxes[1][0].x), std::max(objectBoxes[0][0].y, objectBoxes[1][0].y), std::max(objectBoxes[0][0].z, objectBoxes[1][0].z)},
+                    {std::min(objectBoxes[0][1].x, objectBoxes[1][1].x), std::min(objectBoxes[0][1].y, objectBoxes[1][1].y), std::min(objectBoxes[0][1].z, objectBoxes[1][1].z)}
+                };
+                overlap = surfaceArea(o);
+            }
+            if(overlap > BVH::SPLIT_OVERLAP * b.rootArea)
+            {
+                for(int a = 0;a < 3;a++)
+                {
+                    float lo = axisOf(bounds[0], a);
+                    float width = (axisOf(bounds[1], a) - lo) / BINS;
+                    if(width <= 0) continue;
+                    auto binOf = [&](const float &p)
+                    {
+                        return std::min<size_t>(std::max(0.0f, (p - lo) / width), BINS - 1);
+                    };
+
+                    // chop every reference into the bins it spans, counting where it enters and exits.
+                    size_t entries[BINS] = {0}, exits[BINS] = {0};
+                    vec3 bbounds[BINS][2];
+                    for(size_t i = 0;i < BINS;i++)
+                    {
+                        emptyBox(bbounds[i]);
+                    }
+                    for(const auto &ref : refs)
+                    {
+                        size_t first = binOf(axisOf(ref.bounds[0], a));
+                        size_t last = binOf(axisOf(ref.bounds[1], a));
+                        entries[first]++;
+                        exits[last]++;
+                        for(size_t i = first;i <= last;i++)
+                        {
+                            vec3 part[2];
+                            clipReference(b, ref, a, lo + i * width, i == BINS - 1 ? axisOf(bounds[1], a) : lo + (i + 1) * width, part);
+                            growBox(bbounds[i], part[0], part[1]);
+                        }
+                    }
+
+                    float rightArea[BINS];
+                    size_t rightCount[BINS];
+                    vec3 acc[2];
+                    emptyBox(acc);
+                    size_t n = 0;
+                    for(size_t i = BINS - 1;i > 0;i--)
+                    {
+                        growBox(acc, bbounds[i][0], bbounds[i][1]);
+                        n += exits[i];
+                        rightArea[i] = surfaceArea(acc);
+                        rightCount[i] = n;
+                    }
+                    emptyBox(acc);
+                    n = 0;
+                    for(size_t i = 0;i < BINS - 1;i++)
+                    {
+                        growBox(acc, bbounds[i][0], bbounds[i][1]);
+                        n += entries[i];
+                        float cost = 1 + (n * surfaceArea(acc) + rightCount[i + 1] * rightArea[i + 1]) / area;
+                        if(cost < spatialCost)
+                        {
+                            spatialCost = cost;
+                            spatialAxis = a;
+                            spatialPlane = lo + (i + 1) * width;
+                        }
+                    }
+                }
+            }
+        }
+
+        if(count <= b.leafSize && std::min(objectCost, spatialCost) >= count)
+        {
+            return makeLeaf();
+        }
+
+        if(spatialCost < objectCost)
+        {
+            size_t straddling = 0;
+            for(const auto &ref : refs)
+            {
+                if(axisOf(ref.bounds[0], spatialAxis) < spatialPlane && axisOf(ref.bounds[1], spatialAxis) > spatialPlane)
+                {
+                    straddling++;
+                }
+            }
+            if(straddling <= b.budget)
+            {
+                for(const auto &ref : refs)
+                {
+                    float lo = axisOf(ref.bounds[0], spatialAxis), hi = axisOf(ref.bounds[1], spatialAxis);
+                    if(hi <= spatialPlane)
+                    {
+                        left.push_back(ref);
+                    }
+                    else if(lo >= spatialPlane)
+                    {
+                        right.push_back(ref);
+                    }
+                    else
+                    {
+                        BVHReference l = ref, r = ref;
+                        clipReference(b, ref, spatialAxis, lo, spatialPlane, l.bounds);
+                        clipReference(b, ref, spatialAxis, spatialPlane, hi, r.bounds);
+                        left.push_back(l);
+                        right.push_back(r);
+                    }
+                }
+                if(left.empty() || right.empty() || left.size() == count || right.size() == count)
+                {
+                    // the split made no progress, fall back to the object split.
+                    left.clear();
+                    right.clear();
+                }
+                else
+                {
+                    b.budget -= straddling;
+                    axis = spatialAxis;
+                }
+            }
+        }
+
+        if(left.empty())
+        {
+            size_t mid = 0;
+            if(objectCost < std::numeric_limits<float>::max())
+            {
+                mid = std::partition(refs.begin(), refs.end(), [&](const BVHReference &ref)
+                {
+                    return bucketOf(ref) <= objectSplit;
+                }) - refs.begin();
+            }
+            if(mid == 0 || mid == count)
+            {
+                // no useful split was found, fall back to splitting at the median centroid.
+                mid = count / 2;
+                std::nth_element(refs.begin(), refs.begin() + mid, refs.end(), [&](const BVHReference &l, const BVHReference &r)
+                {
+                    return axisOf(centroidOf(l), axis) < axisOf(centroidOf(r), axis);
+                });
+            }
+            left.assign(refs.begin(), refs.begin() + mid);
+            right.assign(refs.begin() + mid, refs.end());
+        }
+
+        // the references of this node are no longer needed once they are handed to the children.
+        std::vector<BVHReference>().swap(refs);
+        emitSpatial(b, left, depth + 1);
+        uint32_t second = emitSpatial(b, right, depth + 1);
+        b.nodes[index].offset = second;
+        b.nodes[index].count = 0;
+        b.nodes[index].axis = axis;
+        return index;
+    }
+
+    void BVH::buildSpatial(const std::vector<BVHPrimitive> &prims, const BVHClip &clip, const float &budget)
+    {
+        std::vector<BVHReference> refs(prims.size());
+        vec3 bounds[2];
+        emptyBox(bounds);
+        for(size_t i = 0;i < prims.size();i++)
+        {
+            refs[i].bounds[0] = prims[i].bounds[0];
+            refs[i].bounds[1] = prims[i].bounds[1];
+            refs[i].index = i;
+            growBox(bounds, prims[i].bounds[0], prims[i].bounds[1]);
+        }
+        SpatialBuild b = {clip, static_cast<size_t>(std::max(0.0f, budget) * prims.size()), leafSize, surfaceArea(bounds), nodes, indices};
+        nodes.reserve(2 * prims.size());
+        indices.reserve(prims.size() + b.budget);
+        emitSpatial(b, refs, 0);
+        nodes.shrink_to_fit();
+        indices.shrink_to_fit();
+    }
+
+    /**
+     * refitNode:
+     * ----------
+     * recomputes the bounds of the subtree at index from its leaves.  The first
+     * spawn levels refit their second subtree on another thread.
+     */
+    static void refitNode(std::vector<BVHNode> &nodes, const std::vector<uint32_t> &indices, const std::vector<BVHPrimitive> &prims, const uint32_t &index, const size_t &spawn)
+    {
+        BVHNode &node = nodes[index];
+        vec3 bounds[2];
+        emptyBox(bounds);
+        if(node.count > 0)
+        {
+            for(uint32_t i = node.offset;i < node.offset + node.count;i++)
+            {
+                growBox(bounds, prims[indices[i]].bounds[0], prims[indices[i]].bounds[1]);
+            }
+        }
+        else
+        {
+            if(spawn > 0)
+            {
+                std::thread thread(refitNode, std::ref(nodes), std::cref(indices), std::cref(prims), node.offset, spawn - 1);
+                refitNode(nodes, indices, prims, index + 1, spawn - 1);
+                thread.join();
+            }
+            else
+            {
+                refitNode(nodes, indices, prims, index + 1, 0);
+                refitNode(nodes, indices, prims, node.offset, 0);
+            }
+            growBox(bounds, nodes[index + 1].bounds[0], nodes[index + 1].bounds[1]);
+            growBox(bounds, nodes[node.offset].bounds[0], nodes[node.offset].bounds[1]);
+        }
+        node.bounds[0] = bounds[0];
+        node.bounds[1] = bounds[1];
+    }
+
+    bool BVH::refit(const std::vector<BVHPrimitive> &prims, const float &threshold)
+    {
+        if(nodes.empty()) return prims.empty();
+        if(builtCost <= 0)
+        {
+            builtCost = cost();
+        }
+        size_t spawn = 0;
+        while((size_t(1) << spawn) < threadCount(prims.size()))
+        {
+            spawn++;
+        }
+        refitNode(nodes, indices, prims, 0, spawn);
+        collapse();
+        return cost() <= threshold * builtCost;
+    }
+
+    void BVH::alignLeaves(const size_t &width)
+    {
+        size_t size = 0;
+        for(const auto &node : nodes)
+        {
+            if(node.count > 0)
+            {
+                size += (node.count + width - 1) / width * width;
+            }
+        }
+        std::vector<uint32_t> aligned(size, PADDING);
+        size = 0;
+        for(auto &node : nodes)
+        {
+            if(node.count == 0) continue;
+            std::copy(indices.begin() + node.offset, indices.begin() + node.offset + node.count, aligned.begin() + size);
+            node.offset = size;
+            size += (node.count + width - 1) / width * width;
+        }
+        indices.swap(aligned);
+        collapse();
+    }
+
+    float BVH::cost() const
+    {
+        if(nodes.empty()) return 0;
+        float root = surfaceArea(nodes[0].bounds);
+        if(root <= 0) return 0;
+        float sum = 0;
+        for(const auto &node : nodes)
+        {
+            sum += surfaceArea(node.bounds) * (node.count > 0 ? node.count : 1);
+        }
+        return sum / root;
+    }
+
+    void BVH::collapse()
+    {
+        wide.clear();
+        if(nodes.empty()) return;
+        wide.reserve(nodes.size() / 2 + 1);
+        if(nodes[0].count > 0)
+        {
+            // a single leaf still needs a wide root above it.
+            BVHNode4 root;
+            for(int a = 0;a < 3;a++)
+            {
+                std::fill(root.bmin[a], root.bmin[a] + 4, std::numeric_limits<float>::max());
+                std::fill(root.bmax[a], root.bmax[a] + 4, -std::numeric_limits<float>::max());
+                root.bmin[a][0] = axisOf(nodes[0].bounds[0], a);
+                root.bmax[a][0] = axisOf(nodes[0].bounds[1], a);
+            }
+            std::fill(root.child, root.child + 4, 0);
+            std::fill(root.count, root.count + 4, 0);
+            root.child[0] = nodes[0].offset;
+            root.count[0] = nodes[0].count;
+            wide.push_back(root);
+            return;
+        }
+        collapseNode(0);
+    }
+
+    uint32_t BVH::collapseNode(const uint32_t &index)
+    {
+        // open up the interior child with the largest surface area until there are four children.
+        uint32_t children[4] = {index + 1, nodes[index].offset};
+        int n = 2;
+        while(n < 4)
+        {
+            int best = -1;
+            float bestArea = -1;
+            for(int i = 0;i < n;i++)
+            {
+                const BVHNode &child = nodes[children[i]];
+                float area = surfaceArea(child.bounds);
+                if(child.count == 0 && area > bestArea)
+                {
+                    best = i;
+                    bestArea = area;
+                }
+            }
+            if(best < 0) break;
+            uint32_t opened = children[best];
+            children[best] = opened + 1;
+            children[n++] = nodes[opened].offset;
+        }
+
+        uint32_t windex = wide.size();
+        wide.push_back(BVHNode4());
+        BVHNode4 node;
+        for(int i = 0;i < 4;i++)
+        {
+            if(i >= n)
+            {
+                for(int a = 0;a < 3;a++)
+                {
+                    node.bmin[a][i] = std::numeric_limits<float>::max();
+                    node.bmax[a][i] = -std::numeric_limits<float>::max();
+                }
+                node.child[i] = 0;
+                node.count[i] = 0;
+                continue;
+            }
+            const BVHNode &child = nodes[children[i]];
+            for(int a = 0;a < 3;a++)
+            {
+                node.bmin[a][i] = axisOf(child.bounds[0], a);
+                node.bmax[a][i] = axisOf(child.bounds[1], a);
+            }
+            if(child.count > 0)
+            {
+                node.child[i] = child.offset;
+                node.count[i] = child.count;
+            }
+            else
+            {
+                node.child[i] = collapseNode(children[i]);
+                node.count[i] = 0;
+            }
+        }
+        wide[windex] = node;
+        return windex;
+    }
+
+    bool BVH::empty() const
+    {
+        return nodes.empty();
+    }
+
+    void BVH::clear()
+    {
+        builtCost = 0;
+        nodes.clear();
+        indices.clear();
+        wide.clear();
+    }
+
+    BVHContainer::BVHContainer(const BVH::BuildMode &mode, const float &budget):mode(mode), budget(budget)
+    {}
+
+    bool BVHContainer::intersect(const Ray &ray, float &t) const
+    {
+        if(bvh.empty())
+        {
+            // not built yet, fall back to testing everything.
+            bool hit = false;
+            for(auto s : shapes)
+            {
+                if(s->intersect(ray, t))
+                {
+                    hit = true;
+                }
+            }
+            return hit;
+        }
+        return bvh.intersect(ray, t, [this](const uint32_t &i, const Ray &ray, float &t)
+        {
+            return primitives.intersect(primitives.refs[i], ray, t);
+        });
+    }
+
+    void BVHContainer::intersectPacket(const RayPacket &packet, float *t) const
+    {
+        if(bvh.empty() || !packet.coherent)
+        {
+            ShapeContainer::intersectPacket(packet, t);
+            return;
+        }
+        bvh.traversePacket(packet, t, [this](const uint32_t &offset, const uint32_t &count, const RayPacket &packet, float *t)
+        {
+            for(uint32_t i = 0;i < count;i++)
+            {
+                primitives.intersectPacket(primitives.refs[bvh.indices[offset + i]], packet, t);
+            }
+        });
+    }
+
+    void BVHContainer::addShape(Shape *shape)
+    {
+        shapes.push_back(shape);
+        bvh.clear();
+    }
+
+    size_t BVHContainer::size() const
+    {
+        return shapes.size();
+    }
+
+    void BVHContainer::bounds(std::vector<BVHPrimitive> &prims) const
+    {
+        prims.resize(shapes.size());
+        parallelChunks(shapes.size(), threadCount(shapes.size()), [&](size_t, size_t begin, size_t end)
+        {
+            for(size_t i = begin;i < end;i++)
+            {
+                shapes[i]->extents(prims[i].bounds[0], prims[i].bounds[1]);
+                prims[i].centroid = (prims[i].bounds[0] + prims[i].bounds[1]) / 2;
+            }
+        });
+    }
+
+    void BVHContainer::build()
+    {
+        std::vector<BVHPrimitive> prims;
+        bounds(prims);
+        primitives.assign(shapes);
+        bvh.build(prims, mode, nullptr, budget);
+    }
+
+    bool BVHContainer::refit()
+    {
+        std::vector<BVHPrimitive> prims;
+        bounds(prims);
+        primitives.assign(shapes);
+        if(!bvh.empty() && bvh.refit(prims))
+        {
+            return false;
+        }
+        bvh.build(prims, mode, nullptr, budget);
+        return true;
+    }
+};
@@ -0,0 +1,485 @@
+#ifndef __BVH_HPP__
+#define __BVH_HPP__
+
+#include "vec3.hpp"
+#include "ray.hpp"
+#include "shape.hpp"
+#include "primitives.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#ifdef __FMA__
+#include <immintrin.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+#include <utility>
+#include <vector>
+
+namespace rt
+{
+    /**
+     * BVHPrimitive:
+     * -------------
+     * the build input for a single primitive: its bounds and centroid.
+     */
+    struct BVHPrimitive
+    {
+        vec3 bounds[2];
+        vec3 centroid;
+    };
+
+    /**
+     * BVHClip:
+     * --------
+     * computes the bounds of the part of primitive index lying in the slab
+     * lo <= p[axis] <= hi.  Spatial splits use it to cut primitives in two;
+     * without one the primitive bounds are cut as boxes.
+     */
+    typedef std::function<void(const uint32_t &index, const int &axis, const float &lo, const float &hi, vec3 bounds[2])> BVHClip;
+
+    /**
+     * BVHNode:
+     * --------
+     * a node of a flattened bounding volume hierarchy.  Nodes are stored depth
+     * first, so the first child of an interior node always directly follows it.
+     */
+    struct BVHNode
+    {
+        vec3 bounds[2];
+        uint32_t offset;    // leaf: first entry in the index list, interior: second child
+        uint16_t count;     // number of primitives in a leaf, 0 for interior nodes
+        uint16_t axis;      // the axis the node was split on
+    };
+
+    /**
+     * BVHNode4:
+     * ---------
+     * a node of the 4 wide hierarchy used for traversal.  The child boxes are
+     * stored one axis at a time so all four can be tested with one SIMD slab
+     * test.  Unused child slots hold an empty box which no ray can hit.
+     */
+    struct alignas(16) BVHNode4
+    {
+        float bmin[3][4];
+        float bmax[3][4];
+        uint32_t child[4];  // leaf: first entry in the index list, interior: the child node
+        uint16_t count[4];  // number of primitives in a leaf, 0 for interior children
+    };
+
+    /**
+     * raybox4:
+     * --------
+     * tests a ray against the four child boxes of a wide node at once.
+     *
+     * @param ray: Ray the incoming ray.
+     * @param node: BVHNode4 the node holding the boxes.
+     * @param t: float only boxes entered before t count as hit.
+     * @param tnear: float[4] the entry distance of each child.
+     * @return a mask with bit i set if child i was hit.
+     */
+    inline int raybox4(const Ray &ray, const BVHNode4 &node, const float &t, float tnear[4])
+    {
+        // picking the near and far planes by the direction sign keeps empty boxes empty.
+        const float *near[3], *far[3];
+        for(int a = 0;a < 3;a++)
+        {
+            near[a] = ray.sign[a] ? node.bmax[a] : node.bmin[a];
+            far[a] = ray.sign[a] ? node.bmin[a] : node.bmax[a];
+        }
+#ifdef __SSE__
+        __m128 ox = _mm_set1_ps(ray.oinvdir.x), oy = _mm_set1_ps(ray.oinvdir.y), oz = _mm_set1_ps(ray.oinvdir.z);
+        __m128 ix = _mm_set1_ps(ray.invdir.x), iy = _mm_set1_ps(ray.invdir.y), iz = _mm_set1_ps(ray.invdir.z);
+#ifdef __FMA__
+        auto slab4 = [](const float *p, __m128 inv, __m128 oinv) {return _mm_fmsub_ps(_mm_load_ps(p), inv, oinv);};
+#else
+        auto slab4 = [](const float *p, __m128 inv, __m128 oinv) {return _mm_sub_ps(_mm_mul_ps(_mm_load_ps(p), inv), oinv);};
+#endif
+        __m128 n = _mm_max_ps(_mm_max_ps(slab4(near[0], ix, ox), slab4(near[1], iy, oy)), slab4(near[2], iz, oz));
+        __m128 f = _mm_min_ps(_mm_min_ps(slab4(far[0], ix, ox), slab4(far[1], iy, oy)), slab4(far[2], iz, oz));
+        __m128 hit = _mm_and_ps(_mm_and_ps(_mm_cmple_ps(n, f), _mm_cmpge_ps(f, _mm_setzero_ps())),
+                                _mm_cmple_ps(n, _mm_set1_ps(t)));
+        _mm_storeu_ps(tnear, n);
+        return _mm_movemask_ps(hit);
+#else
+        const float oinv[3] = {ray.oinvdir.x, ray.oinvdir.y, ray.oinvdir.z};
+        const float inv[3] = {ray.invdir.x, ray.invdir.y, ray.invdir.z};
+        int mask = 0;
+        for(int i = 0;i < 4;i++)
+        {
+            float n = -std::numeric_limits<float>::infinity(), f = std::numeric_limits<float>::infinity();
+            for(int a = 0;a < 3;a++)
+            {
+                n = std::max(n, slab(near[a][i], inv[a], oinv[a]));
+                f = std::min(f, slab(far[a][i], inv[a], oinv[a]));
+            }
+            tnear[i] = n;
+            if(n <= f && f >= 0 && n <= t)
+            {
+                mask |= 1 << i;
+            }
+        }
+        return mask;
+#endif
+    }
+
+    /**
+     * packetbox4:
+     * -----------
+     * tests a coherent ray packet against the four child boxes of a wide node
+     * at once, with interval arithmetic over the reciprocal directions of the
+     * rays.  A child is reported hit if any ray of the packet might hit it.
+     *
+     * @param packet: RayPacket the incoming rays, which have to be coherent.
+     * @param node: BVHNode4 the node holding the boxes.
+     * @param t: float only boxes entered before t count as hit.
+     * @param tnear: float[4] a lower bound on the entry distance of each child.
+     * @return a mask with bit i set if child i may be hit.
+     */
+    inline int packetbox4(const RayPacket &packet, const BVHNode4 &node, const float &t, float tnear[4])
+    {
+        const Ray &first = packet.rays[0];
+        const float o[3] = {first.orig.x, first.orig.y, first.orig.z};
+        const float imin[3] = {packet.invmin.x, packet.invmin.y, packet.invmin.z};
+        const float imax[3] = {packet.invmax.x, packet.invmax.y, packet.invmax.z};
+        const float *near[3], *far[3];
+        for(int a = 0;a < 3;a++)
+        {
+            near[a] = first.sign[a] ? node.bmax[a] : node.bmin[a];
+            far[a] = first.sign[a] ? node.bmin[a] : node.bmax[a];
+        }
+        int mask = 0;
+        for(int i = 0;i < 4;i++)
+        {
+            float n = -std::numeric_limits<float>::infinity(), f = std::numeric_limits<float>::infinity();
+            for(int a = 0;a < 3;a++)
+            {
+                // no ray enters the slab before the smaller product, or leaves it after the larger.
+                float dn = near[a][i] - o[a], df = far[a][i] - o[a];
+                n = std::max(n, std::min(dn * imin[a], dn * imax[a]));
+                f = std::min(f, std::max(df * imin[a], df * imax[a]));
+            }
+            tnear[i] = n;
+            if(n <= f && f >= 0 && n <= t)
+            {
+                mask |= 1 << i;
+            }
+        }
+        return mask;
+    }
+
+    /**
+     * BVH:
+     * ----
+     * a bounding volume hierarchy over an indexed set of primitives.  The
+     * hierarchy only knows about primitive bounds; the owner supplies the
+     * primitive intersection test during traversal.
+     *
+     * The builders produce a binary tree, which is what gets stored and
+     * cached.  It is then collapsed into a 4 wide tree for traversal.
+     */
+    class BVH
+    {
+    public:
+        /**
+         * BuildMode:
+         * ----------
+         * SAH: top down binned surface area heuristic, the best trees.
+         * MORTON: linear BVH over 30 bit Morton codes, the fastest builds.
+         * SPATIAL: SAH with spatial splits, which may reference a primitive
+         *          from several leaves.  Best for large, thin or overlapping
+         *          primitives such as walls.
+         */
+        enum BuildMode {SAH, MORTON, SPATIAL};
+
+        static constexpr size_t MAX_LEAF_SIZE = 4;
+        static constexpr size_t SAH_BUCKETS = 16;
+        // past this depth the build falls back to median splits, which bounds the traversal stack.
+        static constexpr size_t MAX_DEPTH = 64;
+        static constexpr size_t STACK_SIZE = MAX_DEPTH + 32;
+        // extra references a spatial build may add, as a fraction of the primitive count.
+        static constexpr float DEFAULT_SPLIT_BUDGET = 0.3f;
+        // spatial splits are only tried when the object split children overlap by more than this much of the root area.
+        static constexpr float SPLIT_OVERLAP = 1e-5f;
+        // a refit tree is rebuilt once its SAH cost grows past this multiple of the cost when it was built.
+        static constexpr float REFIT_THRESHOLD = 1.5f;
+        // every wide node visited leaves at most three siblings behind on the stack.
+        static constexpr size_t WIDE_STACK_SIZE = 3 * STACK_SIZE + 1;
+
+        /**
+         * build:
+         * ------
+         * builds the hierarchy.
+         *
+         * @param prims: vector<BVHPrimitive> the bounds of every primitive.
+         * @param mode: BuildMode the builder to use.
+         * @param clip: BVHClip clips a primitive to a slab, only used by SPATIAL.
+         * @param budget: float extra references SPATIAL may add, as a fraction of the primitive count.
+         * @param leafSize: size_t the most primitives a leaf may hold.
+         * NOTE: with spatial splits indices may hold the same primitive more than once.
+         */
+        void build(const std::vector<BVHPrimitive> &prims, const BuildMode &mode=SAH, const BVHClip &clip=nullptr, const float &budget=DEFAULT_SPLIT_BUDGET, const size_t &leafSize=MAX_LEAF_SIZE);
+
+        /**
+         * alignLeaves:
+         * ------------
+         * spaces the index list out so every leaf starts at a multiple of width,
+         * letting the owner keep per leaf data in blocks of width primitives.
+         * The gaps are filled with PADDING.
+         *
+         * @param width: size_t the alignment, at least the leaf size the tree was built with.
+         */
+        void alignLeaves(const size_t &width);
+        static constexpr uint32_t PADDING = 0xffffffff;
+
+        /**
+         * refit:
+         * ------
+         * recomputes the node bounds bottom up after the primitives moved,
+         * keeping the tree as it is.  Large trees are refit in parallel.
+         *
+         * @param prims: vector<BVHPrimitive> the new bounds of every primitive, in the order they were built with.
+         * @param threshold: float how much the SAH cost may grow before the tree is considered worn out.
+         * @return false if the refit tree is worn out and should be rebuilt, true otherwise.
+         */
+        bool refit(const std::vector<BVHPrimitive> &prims, const float &threshold=REFIT_THRESHOLD);
+
+        /**
+         * cost:
+         * -----
+         * the surface area heuristic cost of the tree, relative to its root.
+         */
+        float cost() const;
+
+        /**
+         * intersect:
+         * ----------
+         * traverses the hierarchy front to back, calling leaf for every
+         * primitive in a leaf the ray reaches.
+         *
+         * @param ray: Ray the incoming ray.
+         * @param t: float the distance to the closest intersection so far.
+         * @param leaf: callable (uint32_t index, const Ray &ray, float &t) -> bool.
+         * @return true if any primitive was hit, false otherwise.
+         */
+        template<typename Leaf>
+        bool intersect(const Ray &ray, float &t, Leaf &&leaf) const;
+
+        /**
+         * traverse:
+         * ---------
+         * traverses the hierarchy front to back like intersect, but calls leaf
+         * once per leaf with the range of the index list it covers.
+         *
+         * @param ray: Ray the incoming ray.
+         * @param t: float the distance to the closest intersection so far.
+         * @param leaf: callable (uint32_t offset, uint32_t count, const Ray &ray, float &t) -> bool.
+         * @return true if any leaf reported a hit, false otherwise.
+         */
+        template<typename Leaf>
+        bool traverse(const Ray &ray, float &t, Leaf &&leaf) const;
+
+        /**
+         * traversePacket:
+         * ---------------
+         * traverses the hierarchy front to back with a whole coherent packet,
+         * testing boxes once for all of its rays.  The rays only part ways at
+         * the leaves, where leaf tests them one by one.
+         *
+         * @param packet: RayPacket the incoming rays, which have to be coherent.
+         * @param t: float[] the distance to the closest intersection so far of each ray.
+         * @param leaf: callable (uint32_t offset, uint32_t count, const RayPacket &packet, float *t) -> void.
+         */
+        template<typename Leaf>
+        void traversePacket(const RayPacket &packet, float *t, Leaf &&leaf) const;
+
+        /**
+         * collapse:
+         * ---------
+         * rebuilds the wide traversal nodes from the binary nodes.
+         * NOTE: needs to be called whenever nodes is filled in by hand.
+         */
+        void collapse();
+
+        bool empty() const;
+        void clear();
+
+        std::vector<BVHNode> nodes;
+        std::vector<uint32_t> indices;
+        std::vector<BVHNode4> wide;
+
+    private:
+        float builtCost = 0;  // the cost of the tree when it was last built, 0 if unknown
+        size_t leafSize = MAX_LEAF_SIZE;
+
+        uint32_t buildRecursive(const std::vector<BVHPrimitive> &prims, size_t start, size_t end, size_t depth);
+        void buildMorton(const std::vector<BVHPrimitive> &prims);
+        void buildSpatial(const std::vector<BVHPrimitive> &prims, const BVHClip &clip, const float &budget);
+        uint32_t collapseNode(const uint32_t &index);
+    };
+
+    /**
+     * BVHContainer:
+     * -------------
+     * a shape container backed by a BVH.
+     */
+    class BVHContainer: public ShapeContainer
+    {
+    public:
+        BVHContainer(const BVH::BuildMode &mode=BVH::SAH, const float &budget=BVH::DEFAULT_SPLIT_BUDGET);
+        virtual bool intersect(const Ray &ray, float &t) const;
+        virtual void intersectPacket(const RayPacket &packet, float *t) const;
+        virtual void addShape(Shape *shape);
+        virtual size_t size() const;
+        virtual void build();
+        virtual bool refit();
+    private:
+        void bounds(std::vector<BVHPrimitive> &prims) const;
+
+        std::vector<Shape*> shapes;
+        PrimitiveSet primitives;
+        BVH bvh;
+        BVH::BuildMode mode;
+        float budget;
+    };
+
+    template<typename Leaf>
+    bool BVH::intersect(const Ray &ray, float &t, Leaf &&leaf) const
+    {
+        return traverse(ray, t, [this, &leaf](const uint32_t &offset, const uint32_t &count, const Ray &ray, float &t)
+        {
+            bool hit = false;
+            for(uint32_t i = 0;i < count;i++)
+            {
+                if(leaf(indices[offset + i], ray, t))
+                {
+                    hit = true;
+                }
+            }
+            return hit;
+        });
+    }
+
+    template<typename Leaf>
+    bool BVH::traverse(const Ray &ray, float &t, Leaf &&leaf) const
+    {
+        if(wide.empty()) return false;
+
+        // (child, count, entry distance) triples still to be visited.
+        uint32_t stack[WIDE_STACK_SIZE];
+        uint16_t counts[WIDE_STACK_SIZE];
+        float entry[WIDE_STACK_SIZE];
+        int top = 0;
+        stack[0] = 0;
+        counts[0] = 0;
+        entry[0] = -std::numeric_limits<float>::infinity();
+        top++;
+        bool hit = false;
+        while(top > 0)
+        {
+            top--;
+            if(entry[top] > t) continue;
+            if(counts[top] > 0)
+            {
+                if(leaf(stack[top], counts[top], ray, t))
+                {
+                    hit = true;
+                }
+                continue;
+            }
+
+            const BVHNode4 &node = wide[stack[top]];
+            float tnear[4];
+            int mask = raybox4(ray, node, t, tnear);
+
+            // order the hit children nearest first, then push them farthest first.
+            int order[4], n = 0;
+            for(int i = 0;i < 4;i++)
+            {
+                if(mask & (1 << i))
+                {
+                    int j = n++;
+                    for(;j > 0 && tnear[order[j - 1]] > tnear[i];j--)
+                    {
+                        order[j] = order[j - 1];
+                    }
+                    order[j] = i;
+                }
+            }
+            for(int j = n - 1;j >= 0;j--)
+            {
+                stack[top] = node.child[order[j]];
+                counts[top] = node.count[order[j]];
+                entry[top] = tnear[order[j]];
+                top++;
+            }
+        }
+        return hit;
+    }
+
+    template<typename Leaf>
+    void BVH::traversePacket(const RayPacket &packet, float *t, Leaf &&leaf) const
+    {
+        if(wide.empty() || packet.size == 0) return;
+
+        float tmax = t[0];
+        for(int i = 1;i < packet.size;i++)
+        {
+            tmax = std::max(tmax, t[i]);
+        }
+
+        uint32_t stack[WIDE_STACK_SIZE];
+        uint16_t counts[WIDE_STACK_SIZE];
+        float entry[WIDE_STACK_SIZE];
+        int top = 0;
+        stack[0] = 0;
+        counts[0] = 0;
+        entry[0] = -std::numeric_limits<float>::infinity();
+        top++;
+        while(top > 0)
+        {
+            top--;
+            if(entry[top] > tmax) continue;
+            if(counts[top] > 0)
+            {
+                leaf(stack[top], counts[top], packet, t);
+                tmax = t[0];
+                for(int i = 1;i < packet.size;i++)
+                {
+                    tmax = std::max(tmax, t[i]);
+                }
+                continue;
+            }
+
+            const BVHNode4 &node = wide[stack[top]];
+            float tnear[4];
+            int mask = packetbox4(packet, node, tmax, tnear);
+
+            int order[4], n = 0;
+            for(int i = 0;i < 4;i++)
+            {
+                if(mask & (1 << i))
+                {
+                    int j = n++;
+                    for(;j > 0 && tnear[order[j - 1]] > tnear[i];j--)
+                    {
+                        order[j] = order[j - 1];
+                    }
+                    order[j] = i;
+                }
+            }
+            for(int j = n - 1;j >= 0;j--)
+            {
+                stack[top] = node.child[order[j]];
+                counts[top] = node.count[order[j]];
+                entry[top] = tnear[order[j]];
+                top++;
+            }
+        }
+    }
+
+}; // namespace
+
+#endif // __BVH_HPP__
@@ -0,0 +1,187 @@
+#include "grid.hpp"
+#include "octree.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace rt
+{
+    constexpr float GridContainer::DENSITY;
+    constexpr int GridContainer::MAX_RESOLUTION;
+
+    GridContainer::GridContainer():built(false)
+    {}
+
+    size_t GridContainer::cellOf(const int &x, const int &y, const int &z) const
+    {
+        return (static_cast<size_t>(z) * resolution[1] + y) * resolution[0] + x;
+    }
+
+    bool GridContainer::intersect(const Ray &ray, float &t) const
+    {
+        if(!built)
+        {
+            // not built yet, fall back to testing everything.
+            bool hit = false;
+            for(auto s : shapes)
+            {
+                if(s->intersect(ray, t))
+                {
+                    hit = true;
+                }
+            }
+            return hit;
+        }
+        float tmin, tmax;
+        if(!raybox(ray, bounds, tmin, tmax) || tmax < 0 || tmin > t) return false;
+        tmin = std::max(tmin, 0.0f);
+
+        // set up the walk from the cell the ray enters the grid in.
+        const float orig[3] = {ray.orig.x, ray.orig.y, ray.orig.z};
+        const float dir[3] = {ray.dir.x, ray.dir.y, ray.dir.z};
+        const float invdir[3] = {ray.invdir.x, ray.invdir.y, ray.invdir.z};
+        const float bmin[3] = {bounds[0].x, bounds[0].y, bounds[0].z};
+        const float size[3] = {cellSize.x, cellSize.y, cellSize.z};
+        int cell[3], step[3], out[3];
+        float next[3], delta[3];
+        for(int a = 0;a < 3;a++)
+        {
+            float p = orig[a] + dir[a] * tmin;
+            cell[a] = std::min(std::max(static_cast<int>((p - bmin[a]) / size[a]), 0), resolution[a] - 1);
+            if(dir[a] > 0)
+            {
+                step[a] = 1;
+                out[a] = resolution[a];
+                next[a] = (bmin[a] + (cell[a] + 1) * size[a] - orig[a]) * invdir[a];
+                delta[a] = size[a] * invdir[a];
+            }
+            else if(dir[a] < 0)
+            {
+                step[a] = -1;
+                out[a] = -1;
+                next[a] = (bmin[a] + cell[a] * size[a] - orig[a]) * invdir[a];
+                delta[a] = -size[a] * invdir[a];
+            }
+            else
+            {
+                step[a] = 0;
+                out[a] = -1;
+                next[a] = std::numeric_limits<float>::infinity();
+                delta[a] = std::numeric_limits<float>::infinity();
+            }
+        }
+
+        Mailbox mailbox;
+        bool hit = false;
+        while(true)
+        {
+            size_t c = cellOf(cell[0], cell[1], cell[2]);
+            for(uint32_t i = cellStart[c];i < cellStart[c + 1];i++)
+            {
+                uint32_t index = cellShapes[i];
+                if(mailbox.insert(index) && primitives.intersect(primitives.refs[index], ray, t))
+                {
+                    hit = true;
+                }
+            }
+
+            // a hit inside this cell cannot be beaten by any cell further along.
+            int a = next[0] < next[1] ? (next[0] < next[2] ? 0 : 2) : (next[1] < next[2] ? 1 : 2);
+            if(next[a] >= t) break;
+            cell[a] += step[a];
+            if(cell[a] == out[a]) break;
+            next[a] += delta[a];
+        }
+        return hit;
+    }
+
+    void GridContainer::addShape(Shape *shape)
+    {
+        shapes.push_back(shape);
+        built = false;
+    }
+
+    size_t GridContainer::size() const
+    {
+        return shapes.size();
+    }
+
+    void GridContainer::build()
+    {
+        cellStart.clear();
+        cellShapes.clear();
+        if(shapes.empty()) return;
+        primitives.assign(shapes);
+
+        std::vector<vec3> extents(2 * shapes.size());
+        for(size_t i = 0;i < shapes.size();i++)
+        {
+            shapes[i]->extents(extents[2 * i], extents[2 * i + 1]);
+            if(i == 0)
+            {
+                bounds[0] = extents[0];
+                bounds[1] = extents[1];
+            }
+            else
+            {
+                const vec3 &smin = extents[2 * i], &smax = extents[2 * i + 1];
+                bounds[0] = {std::min(bounds[0].x, smin.x), std::min(bounds[0].y, smin.y), std::min(bounds[0].z, smin.z)};
+                bounds[1] = {std::max(bounds[1].x, smax.x), std::max(bounds[1].y, smax.y), std::max(bounds[1].z, smax.z)};
+            }
+        }
+
+        // pick cubic cells so the grid holds about DENSITY cells per shape.  Flat
+        // scenes are padded so the volume never collapses to zero.
+        vec3 extent = bounds[1] - bounds[0];
+        float pad = std::max(max(extent), 1e-6f) * 1e-3f;
+        bounds[0] = bounds[0] - vec3{pad, pad, pad};
+        bounds[1] = bounds[1] + vec3{pad, pad, pad};
+        extent = bounds[1] - bounds[0];
+        float side = cbrtf(extent.x * extent.y * extent.z / (DENSITY * shapes.size()));
+        const float e[3] = {extent.x, extent.y, extent.z};
+        for(int a = 0;a < 3;a++)
+        {
+            resolution[a] = std::min(std::max(static_cast<int>(e[a] / side), 1), MAX_RESOLUTION);
+        }
+        cellSize = {extent.x / resolution[0], extent.y / resolution[1], extent.z / resolution[2]};
+
+        // count the shapes per cell first, so the cell lists can be packed into one array.
+        auto cellRange = [&](const size_t &i, int lo[3], int hi[3])
+        {
+            const float smin[3] = {extents[2 * i].x - bounds[0].x, extents[2 * i].y - bounds[0].y, extents[2 * i].z - bounds[0].z};
+            const float smax[3] = {extents[2 * i + 1].x - bounds[0].x, extents[2 * i + 1].y - bounds[0].y, extents[2 * i + 1].z - bounds[0].z};
+            const float size[3] = {cellSize.x, cellSize.y, cellSize.z};
+            for(int a = 0;a < 3;a++)
+            {
+                lo[a] = std::min(std::max(static_cast<int>(smin[a] / size[a]), 0), resolution[a] - 1);
+                hi[a] = std::min(std::max(static_cast<int>(smax[a] / size[a]), 0), resolution[a] - 1);
+            }
+        };
+        cellStart.assign(static_cast<size_t>(resolution[0]) * resolution[1] * resolution[2] + 1, 0);
+        for(size_t i = 0;i < shapes.size();i++)
+        {
+            int lo[3], hi[3];
+            cellRange(i, lo, hi);
+            for(int z = lo[2];z <= hi[2];z++)
+                for(int y = lo[1];y <= hi[1];y++)
+                    for(int x = lo[0];x <= hi[0];x++)
+                        cellStart[cellOf(x, y, z) + 1]++;
+        }
+        for(size_t c = 1;c < cellStart.size();c++)
+        {
+            cellStart[c] += cellStart[c - 1];
+        }
+        cellShapes.resize(cellStart.back());
+        std::vector<uint32_t> fill(cellStart.begin(), cellStart.end() - 1);
+        for(size_t i = 0;i < shapes.size();i++)
+        {
+            int lo[3], hi[3];
+            cellRange(i, lo, hi);
+            for(int z = lo[2];z <= hi[2];z++)
+                for(int y = lo[1];y <= hi[1];y++)
+                    for(int x = lo[0];x <= hi[0];x++)
+                        cellShapes[fill[cellOf(x, y, z)]++] = i;
+        }
+        built = true;
+    }
+};
@@ -0,0 +1,49 @@
+#ifndef __GRID_HPP__
+#define __GRID_HPP__
+
+#include "vec3.hpp"
+#include "ray.hpp"
+#include "shape.hpp"
+#include "primitives.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace rt
+{
+    /**
+     * GridContainer:
+     * --------------
+     * a shape container backed by a uniform grid.  Every shape is listed in
+     * each cell its bounds overlap, and rays walk the cells in order with a
+     * 3D-DDA.  It builds in linear time and suits dense scenes of many shapes
+     * of similar size, such as particle or sphere clouds.
+     */
+    class GridContainer: public ShapeContainer
+    {
+    public:
+        // cells per shape, the resolution is picked so the grid holds about this many.
+        static constexpr float DENSITY = 3.0f;
+        static constexpr int MAX_RESOLUTION = 512;
+
+        GridContainer();
+        virtual bool intersect(const Ray &ray, float &t) const;
+        virtual void addShape(Shape *shape);
+        virtual size_t size() const;
+        virtual void build();
+    private:
+        size_t cellOf(const int &x, const int &y, const int &z) const;
+
+        std::vector<Shape*> shapes;
+        PrimitiveSet primitives;
+        vec3 bounds[2];
+        vec3 cellSize;
+        int resolution[3];
+        std::vector<uint32_t> cellStart;    // the shapes of cell i are cellShapes[cellStart[i]] to cellShapes[cellStart[i + 1]]
+        std::vector<uint32_t> cellShapes;
+        bool built;
+    };
+
+}; // namespace
+
+#endif // __GRID_HPP__
@@ -0,0 +1,95 @@
+#include "image-io.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace rt
+{
+    static bool littleEndian()
+    {
+        uint16_t one = 1;
+        return *reinterpret_cast<const unsigned char *>(&one) == 1;
+    }
+
+    /**
+     * writeImage:
+     * -----------
+     * writes a text header followed by the pixel data.  Both are gathered in
+     * one buffer first, so the file is written with a single call.
+     */
+    static bool writeImage(const std::string &filename, const std::string &header, const char *data, const size_t &size)
+    {
+        std::vector<char> buffer(header.size() + size);
+        memcpy(buffer.data(), header.data(), header.size());
+        memcpy(buffer.data() + header.size(), data, size);
+        std::ofstream f(filename, std::ios::binary);
+        f.write(buffer.data(), buffer.size());
+        return f.good();
+    }
+
+    bool writePGM(const std::string &filename, const unsigned char *pix, const int &width, const int &height)
+    {
+        std::string header = "P5\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+        return writeImage(filename, header, reinterpret_cast<const char *>(pix), static_cast<size_t>(width) * height);
+    }
+
+    bool writePPM(const std::string &filename, const unsigned char *pix, const int &width, const int &height)
+    {
+        std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+        return writeImage(filename, header, reinterpret_cast<const char *>(pix), static_cast<size_t>(width) * height * 3);
+    }
+
+    bool writePFM(const std::string &filename, const float *pix, const int &width, const int &height, const int &channels)
+    {
+        // a negative scale marks little endian data, the floats are written in the native order.
+        std::string header = std::string(channels == 3 ? "PF" : "Pf") + "\n" + std::to_string(width) + " " + std::to_string(height) + "\n" + (littleEndian() ? "-1.0" : "1.0") + "\n";
+
+        // PFM stores the rows from the bottom up.
+        size_t row = static_cast<size_t>(width) * channels;
+        std::vector<float> flipped(row * height);
+        for(int j = 0;j < height;j++)
+        {
+            memcpy(&flipped[(height - 1 - j) * row], pix + j * row, row * sizeof(float));
+        }
+        return writeImage(filename, header, reinterpret_cast<const char *>(flipped.data()), flipped.size() * sizeof(float));
+    }
+
+    bool writeRaw(const std::string &filename, const float *pix, const int &width, const int &height, const int &channels)
+    {
+        // the sidecar is only written once the data is, so a failed write never leaves a sidecar describing missing data.
+        std::string json = filename + ".json";
+        std::ofstream f(filename, std::ios::binary);
+        if(!f.is_open())
+        {
+            return false;
+        }
+        f.write(reinterpret_cast<const char *>(pix), static_cast<size_t>(width) * height * channels * sizeof(float));
+        f.close();
+        if(f.fail())
+        {
+            std::remove(filename.c_str());
+            return false;
+        }
+
+        std::ofstream sidecar(json);
+        sidecar << "{\n"
+                << "    \"width\": " << width << ",\n"
+                << "    \"height\": " << height << ",\n"
+                << "    \"channels\": " << channels << ",\n"
+                << "    \"dtype\": \"float32\",\n"
+                << "    \"endianness\": \"" << (littleEndian() ? "little" : "big") << "\",\n"
+                << "    \"order\": \"row-major, top to bottom\"\n"
+                << "}\n";
+        sidecar.close();
+        if(sidecar.fail())
+        {
+            std::remove(json.c_str());
+            std::remove(filename.c_str());
+            return false;
+        }
+        return true;
+    }
+};
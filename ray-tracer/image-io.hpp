@@ -0,0 +1,66 @@
+#ifndef __IMAGE_IO_HPP__
+#define __IMAGE_IO_HPP__
+
+#include <string>
+
+namespace rt
+{
+    /**
+     * writePGM:
+     * ---------
+     * writes an 8 bit grayscale image as a binary PGM (P5) file.
+     *
+     * @param filename: string the name of the file.
+     * @param pix: unsigned char* width * height pixels, row by row from the top.
+     * @param width: int the width of the image.
+     * @param height: int the height of the image.
+     * @return true if the file was written, false otherwise.
+     */
+    bool writePGM(const std::string &filename, const unsigned char *pix, const int &width, const int &height);
+
+    /**
+     * writePPM:
+     * ---------
+     * writes an 8 bit color image as a binary PPM (P6) file.
+     *
+     * @param filename: string the name of the file.
+     * @param pix: unsigned char* width * height pixels of red, green and blue, row by row from the top.
+     * @param width: int the width of the image.
+     * @param height: int the height of the image.
+     * @return true if the file was written, false otherwise.
+     */
+    bool writePPM(const std::string &filename, const unsigned char *pix, const int &width, const int &height);
+
+    /**
+     * writePFM:
+     * ---------
+     * writes a 32 bit float image as a PFM (Portable Float Map) file, which
+     * keeps the full precision of the distances.
+     *
+     * @param filename: string the name of the file.
+     * @param pix: float* width * height pixels of channels floats each, row by row from the top.
+     * @param width: int the width of the image.
+     * @param height: int the height of the image.
+     * @param channels: int 1 for a grayscale (Pf) file, 3 for a color (PF) one.
+     * @return true if the file was written, false otherwise.
+     */
+    bool writePFM(const std::string &filename, const float *pix, const int &width, const int &height, const int &channels=1);
+
+    /**
+     * writeRaw:
+     * ---------
+     * writes a 32 bit float image as headerless native order floats, row by
+     * row from the top, so it can be mapped or read straight into an array.
+     * The size and layout go in a JSON sidecar named filename + ".json".
+     *
+     * @param filename: string the name of the file.
+     * @param pix: float* width * height pixels of channels floats each, row by row from the top.
+     * @param width: int the width of the image.
+     * @param height: int the height of the image.
+     * @param channels: int the number of floats per pixel.
+     * @return true if both files were written, false otherwise, in which case neither is left behind.
+     */
+    bool writeRaw(const std::string &filename, const float *pix, const int &width, const int &height, const int &channels=1);
+};
+
+#endif // __IMAGE_IO_HPP__
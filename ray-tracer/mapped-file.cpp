@@ -0,0 +1,70 @@
+#include "mapped-file.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace rt
+{
+    MappedFile::MappedFile():ptr(nullptr), length(0)
+    {}
+
+    MappedFile::~MappedFile()
+    {
+        close();
+    }
+
+    bool MappedFile::open(const std::string &filename)
+    {
+        close();
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if(fd < 0)
+        {
+            return false;
+        }
+        struct stat st;
+        if(fstat(fd, &st) != 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        length = st.st_size;
+        if(length == 0)
+        {
+            // mmap refuses empty mappings, but an empty file is still a valid file.
+            ::close(fd);
+            ptr = "";
+            return true;
+        }
+        void *p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if(p == MAP_FAILED)
+        {
+            length = 0;
+            return false;
+        }
+        ptr = static_cast<const char *>(p);
+        return true;
+    }
+
+    void MappedFile::close()
+    {
+        if(ptr != nullptr && length > 0)
+        {
+            munmap(const_cast<char *>(ptr), length);
+        }
+        ptr = nullptr;
+        length = 0;
+    }
+
+    const char *MappedFile::data() const
+    {
+        return ptr;
+    }
+
+    size_t MappedFile::size() const
+    {
+        return length;
+    }
+};
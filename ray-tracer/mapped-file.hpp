@@ -0,0 +1,41 @@
+#ifndef __MAPPED_FILE_HPP__
+#define __MAPPED_FILE_HPP__
+
+#include <cstddef>
+#include <string>
+
+namespace rt
+{
+    /**
+     * MappedFile:
+     * -----------
+     * a read only memory mapping of a whole file, unmapped when it goes out of scope.
+     */
+    class MappedFile
+    {
+    public:
+        MappedFile();
+        ~MappedFile();
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        /**
+         * open:
+         * -----
+         * maps a file into memory.
+         *
+         * @param filename: string the name of the file.
+         * @return true if the file was mapped, false otherwise.
+         */
+        bool open(const std::string &filename);
+        void close();
+
+        const char *data() const;
+        size_t size() const;
+    private:
+        const char *ptr;
+        size_t length;
+    };
+};
+
+#endif // __MAPPED_FILE_HPP__
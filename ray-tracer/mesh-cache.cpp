@@ -0,0 +1,104 @@
+#include "mesh-cache.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace rt
+{
+    constexpr size_t MeshCache::DEFAULT_BUDGET;
+
+    MeshCache &MeshCache::global()
+    {
+        static MeshCache cache;
+        return cache;
+    }
+
+    MeshCache::MeshCache():budget(DEFAULT_BUDGET), clock(0)
+    {}
+
+    std::shared_ptr<const TriangleMesh> MeshCache::get(const std::string &filename, const BVH::BuildMode &mode, const float &splitBudget, const std::function<TriangleMesh *()> &load)
+    {
+        std::error_code ec;
+        std::filesystem::path path = std::filesystem::canonical(filename, ec);
+        std::filesystem::file_time_type mtime;
+        uintmax_t fileSize = 0;
+        if(!ec) mtime = std::filesystem::last_write_time(path, ec);
+        if(!ec) fileSize = std::filesystem::file_size(path, ec);
+        if(ec)
+        {
+            // a file that cannot be looked at is not cached, the load reports why.
+            return std::shared_ptr<const TriangleMesh>(load());
+        }
+
+        Key key(path.string(), mode, mode == BVH::SPATIAL ? splitBudget : 0);
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            auto found = entries.find(key);
+            if(found != entries.end() && found->second.mtime == mtime && found->second.fileSize == fileSize)
+            {
+                found->second.lastUse = ++clock;
+                return found->second.mesh;
+            }
+        }
+
+        TriangleMesh *mesh = load();
+        if(mesh == nullptr)
+        {
+            return nullptr;
+        }
+        std::shared_ptr<const TriangleMesh> loaded(mesh);
+
+        std::lock_guard<std::mutex> guard(mutex);
+        Entry &entry = entries[key];
+        if(entry.mesh != nullptr && entry.mtime == mtime && entry.fileSize == fileSize)
+        {
+            // another scene loaded the same file meanwhile.
+            entry.lastUse = ++clock;
+            return entry.mesh;
+        }
+        // a stale entry is replaced, scenes still using its mesh keep their reference.
+        entry = {loaded, mtime, fileSize, mesh->binarySize(), ++clock};
+        evict(budget);
+        return loaded;
+    }
+
+    void MeshCache::setBudget(const size_t &bytes)
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        budget = bytes;
+        evict(budget);
+    }
+
+    void MeshCache::clear()
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        evict(0);
+    }
+
+    size_t MeshCache::size() const
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        return entries.size();
+    }
+
+    void MeshCache::evict(const size_t &budget)
+    {
+        // a mesh only the cache holds is used by no scene.
+        std::vector<std::map<Key, Entry>::iterator> unused;
+        size_t bytes = 0;
+        for(auto it = entries.begin();it != entries.end();++it)
+        {
+            if(it->second.mesh.use_count() == 1)
+            {
+                unused.push_back(it);
+                bytes += it->second.bytes;
+            }
+        }
+        std::sort(unused.begin(), unused.end(), [](const auto &a, const auto &b){return a->second.lastUse < b->second.lastUse;});
+        for(size_t i = 0;i < unused.size() && bytes > budget;i++)
+        {
+            bytes -= unused[i]->second.bytes;
+            entries.erase(unused[i]);
+        }
+    }
+};
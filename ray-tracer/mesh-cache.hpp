@@ -0,0 +1,102 @@
+#ifndef __MESH_CACHE_HPP__
+#define __MESH_CACHE_HPP__
+
+#include "mesh.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+
+namespace rt
+{
+    /**
+     * MeshCache:
+     * ----------
+     * the built meshes of every scene of the process, keyed by the canonical
+     * path of their file and the BVH build they were given, and checked
+     * against the file's modification time and size, so a file is parsed and
+     * built once however many scenes place it, and again only once it
+     * changes.  Meshes are shared, reference counted and read only, by the
+     * scenes using them; a scene wanting another build gets its own entry.
+     * Once no scene uses a mesh it is kept for later scenes, such as the next
+     * scene of a batch, until the meshes nobody uses outgrow the budget, when
+     * the least recently used ones are dropped.
+     */
+    class MeshCache
+    {
+    public:
+        // the default number of bytes of unused meshes kept.
+        static constexpr size_t DEFAULT_BUDGET = size_t(256) << 20;
+
+        /**
+         * global:
+         * -------
+         * @return the cache shared by every scene of the process.
+         */
+        static MeshCache &global();
+
+        MeshCache();
+        MeshCache(const MeshCache &) = delete;
+        MeshCache &operator=(const MeshCache &) = delete;
+
+        /**
+         * get:
+         * ----
+         * looks a built mesh up, loading it if it is not cached or its file has
+         * changed since it was loaded.  Loads run outside the lock, so other
+         * files can be looked up meanwhile; if two scenes load the same mesh at
+         * once, the first one stored is kept and shared.
+         *
+         * @param filename: string the name of the mesh file.
+         * @param mode: BuildMode the BVH build the mesh needs.
+         * @param splitBudget: float the split budget of the build, only part of the key of spatial builds.
+         * @param load: function loading the mesh from the file and building it with mode and budget, returning nullptr on failure.
+         * @return the mesh, or nullptr if it could not be loaded.
+         */
+        std::shared_ptr<const TriangleMesh> get(const std::string &filename, const BVH::BuildMode &mode, const float &splitBudget, const std::function<TriangleMesh *()> &load);
+
+        /**
+         * setBudget:
+         * ----------
+         * sets how many bytes of meshes no scene uses are kept, counted by
+         * their size in the binary mesh format.  Meshes over the budget are
+         * dropped by the next call to get, setBudget or clear.
+         *
+         * @param bytes: size_t the budget, 0 keeps no mesh that no scene uses.
+         */
+        void setBudget(const size_t &bytes);
+
+        // drops every mesh no scene uses.
+        void clear();
+
+        // the number of meshes cached, used or not.
+        size_t size() const;
+    private:
+        // the canonical path, build mode and split budget of a mesh.
+        typedef std::tuple<std::string, int, float> Key;
+
+        struct Entry
+        {
+            std::shared_ptr<const TriangleMesh> mesh;
+            std::filesystem::file_time_type mtime;
+            uintmax_t fileSize;
+            size_t bytes;
+            uint64_t lastUse;
+        };
+
+        // drops the least recently used unused meshes until they fit the budget.
+        void evict(const size_t &budget);
+
+        std::map<Key, Entry> entries;
+        size_t budget;
+        uint64_t clock;
+        mutable std::mutex mutex;
+    };
+};
+
+#endif // __MESH_CACHE_HPP__
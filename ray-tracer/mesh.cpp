@@ -0,0 +1,528 @@
+#include "mesh.hpp"
+#include "mapped-file.hpp"
+#include "obj-loader.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+namespace rt
+{
+    constexpr const char *TriangleMesh::BINARY_EXTENSION;
+
+    TriangleMesh::TriangleMesh():mode(BVH::SAH), budget(0)
+    {}
+
+    TriangleMesh *TriangleMesh::FromObj(const std::string &filename, ThreadPool &pool)
+    {
+        // the file is parsed straight into the mesh's vertex and face storage.
+        TriangleMesh *mesh = new TriangleMesh();
+        if(!loadObj(filename, mesh->vertices, mesh->faces, pool))
+        {
+            delete mesh;
+            return nullptr;
+        }
+        return mesh;
+    }
+
+    /**
+     * MeshCacheHeader:
+     * ----------------
+     * the start of a mesh cache file, followed by the vertex, face, node and index arrays.
+     */
+    struct MeshCacheHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t mode;
+        uint64_t key;
+        uint64_t sourceSize;
+        float budget;
+        uint32_t reserved;
+        uint64_t vertices;
+        uint64_t faces;
+        uint64_t nodes;
+        uint64_t indices;
+    };
+
+    static constexpr char MESH_CACHE_MAGIC[8] = "RTMESH";
+    static constexpr uint32_t MESH_CACHE_VERSION = 5;
+
+    /**
+     * take:
+     * -----
+     * checks that an array read from a file fits in the bytes left of it.
+     * The count is divided rather than multiplied, so a damaged count can
+     * not overflow into a small size.
+     *
+     * @param left: size_t the bytes left, reduced by the array if it fits.
+     * @param count: uint64_t the number of elements in the array.
+     * @param size: size_t the size of one element.
+     * @return true if the array fits, false otherwise.
+     */
+    static bool take(size_t &left, const uint64_t &count, const size_t &size)
+    {
+        if(count > left / size)
+        {
+            return false;
+        }
+        left -= count * size;
+        return true;
+    }
+
+    /**
+     * validTree:
+     * ----------
+     * checks that nodes read from a file form a tree the traversal can walk:
+     * every interior node's children come after it and inside the array, no
+     * node is reached twice, the tree is no deeper than the traversal stack,
+     * and every leaf is a block of indices inside the index array.
+     *
+     * @param nodes: vector<BVHNode> the nodes, the root first.
+     * @param indices: size_t the size of the index array.
+     * @return true if the nodes can be collapsed and traversed, false otherwise.
+     */
+    static bool validTree(const std::vector<BVHNode> &nodes, const size_t &indices)
+    {
+        if(nodes.empty())
+        {
+            return false;
+        }
+        std::vector<uint8_t> parents(nodes.size(), 0);
+        std::vector<size_t> depth(nodes.size(), 0);
+        for(size_t i = 0;i < nodes.size();i++)
+        {
+            const BVHNode &node = nodes[i];
+            if(node.count > 0)
+            {
+                if(node.offset % TriangleBlock::WIDTH != 0 || node.count > TriangleBlock::WIDTH || static_cast<size_t>(node.offset) + node.count > indices)
+                {
+                    return false;
+                }
+                continue;
+            }
+            // children always follow their parent, so every depth is known before it is needed.
+            if(i + 1 >= nodes.size() || node.offset <= i + 1 || node.offset >= nodes.size() || depth[i] + 1 >= BVH::STACK_SIZE)
+            {
+                return false;
+            }
+            for(size_t child : {i + 1, static_cast<size_t>(node.offset)})
+            {
+                if(parents[child]++ > 0)
+                {
+                    return false;
+                }
+                depth[child] = depth[i] + 1;
+            }
+        }
+        return true;
+    }
+
+    TriangleMesh *TriangleMesh::FromCache(const std::string &filename, const uint64_t &key, const uint64_t &sourceSize)
+    {
+        MappedFile file;
+        if(!file.open(filename) || file.size() < sizeof(MeshCacheHeader))
+        {
+            return nullptr;
+        }
+        MeshCacheHeader header;
+        memcpy(&header, file.data(), sizeof(header));
+        size_t left = file.size() - sizeof(header);
+        bool fits = take(left, header.vertices, sizeof(vec3)) && take(left, header.faces, sizeof(uint32_t)) && take(left, header.nodes, sizeof(BVHNode)) && take(left, header.indices, sizeof(uint32_t)) && left == 0;
+        if(memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic)) != 0 || header.version != MESH_CACHE_VERSION || header.key != key || header.sourceSize != sourceSize || !fits || header.faces % 3 != 0 || header.nodes == 0 || header.mode > BVH::SPATIAL)
+        {
+            return nullptr;
+        }
+
+        TriangleMesh *mesh = new TriangleMesh();
+        const char *p = file.data() + sizeof(header);
+        mesh->vertices.resize(header.vertices);
+        memcpy(mesh->vertices.data(), p, header.vertices * sizeof(vec3));
+        p += header.vertices * sizeof(vec3);
+        mesh->faces.resize(header.faces);
+        memcpy(mesh->faces.data(), p, header.faces * sizeof(uint32_t));
+        p += header.faces * sizeof(uint32_t);
+        mesh->bvh.nodes.resize(header.nodes);
+        memcpy(mesh->bvh.nodes.data(), p, header.nodes * sizeof(BVHNode));
+        p += header.nodes * sizeof(BVHNode);
+        mesh->bvh.indices.resize(header.indices);
+        memcpy(mesh->bvh.indices.data(), p, header.indices * sizeof(uint32_t));
+        mesh->mode = static_cast<BVH::BuildMode>(header.mode);
+        mesh->budget = header.budget;
+        for(auto v : mesh->faces)
+        {
+            if(v >= mesh->vertices.size())
+            {
+                delete mesh;
+                return nullptr;
+            }
+        }
+        if(!validTree(mesh->bvh.nodes, mesh->bvh.indices.size()))
+        {
+            delete mesh;
+            return nullptr;
+        }
+        for(auto i : mesh->bvh.indices)
+        {
+            if(i != BVH::PADDING && i >= mesh->size())
+            {
+                delete mesh;
+                return nullptr;
+            }
+        }
+        // the wide nodes are only built once the binary ones are known to form a tree.
+        mesh->bvh.collapse();
+        mesh->buildBlocks();
+        return mesh;
+    }
+
+    bool TriangleMesh::save(const std::string &filename, const uint64_t &key, const uint64_t &sourceSize) const
+    {
+        MeshCacheHeader header;
+        memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+        header.version = MESH_CACHE_VERSION;
+        header.mode = mode;
+        header.key = key;
+        header.sourceSize = sourceSize;
+        header.budget = budget;
+        header.reserved = 0;
+        header.vertices = vertices.size();
+        header.faces = faces.size();
+        header.nodes = bvh.nodes.size();
+        header.indices = bvh.indices.size();
+
+        return writeFile(filename, [&](std::ofstream &f)
+        {
+            f.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            f.write(reinterpret_cast<const char *>(vertices.data()), vertices.size() * sizeof(vec3));
+            f.write(reinterpret_cast<const char *>(faces.data()), faces.size() * sizeof(uint32_t));
+            f.write(reinterpret_cast<const char *>(bvh.nodes.data()), bvh.nodes.size() * sizeof(BVHNode));
+            f.write(reinterpret_cast<const char *>(bvh.indices.data()), bvh.indices.size() * sizeof(uint32_t));
+        });
+    }
+
+    /**
+     * MeshFileHeader:
+     * ---------------
+     * the start of a binary mesh file, followed by the vertex and face arrays.
+     */
+    struct MeshFileHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t reserved;
+        uint64_t vertices;
+        uint64_t triangles;
+        vec3 bounds[2];     // the box around every vertex, for tools that need it without reading the arrays
+    };
+
+    static constexpr char MESH_FILE_MAGIC[8] = "RTBMESH";
+    static constexpr uint32_t MESH_FILE_VERSION = 1;
+
+    TriangleMesh *TriangleMesh::FromBinary(const std::string &filename)
+    {
+        MappedFile file;
+        if(!file.open(filename))
+        {
+            std::cerr << "Error reading mesh: " << filename << std::endl;
+            return nullptr;
+        }
+        TriangleMesh *mesh = FromBinary(file.data(), file.size());
+        if(mesh == nullptr)
+        {
+            std::cerr << "Not a binary mesh, or a damaged one: " << filename << std::endl;
+        }
+        return mesh;
+    }
+
+    TriangleMesh *TriangleMesh::FromBinary(const char *data, const size_t &size)
+    {
+        if(size < sizeof(MeshFileHeader))
+        {
+            return nullptr;
+        }
+        MeshFileHeader header;
+        memcpy(&header, data, sizeof(header));
+        size_t left = size - sizeof(header);
+        bool fits = take(left, header.vertices, sizeof(vec3)) && take(left, header.triangles, 3 * sizeof(uint32_t)) && left == 0;
+        if(memcmp(header.magic, MESH_FILE_MAGIC, sizeof(header.magic)) != 0 || header.version != MESH_FILE_VERSION || !fits)
+        {
+            return nullptr;
+        }
+
+        TriangleMesh *mesh = new TriangleMesh();
+        const char *p = data + sizeof(header);
+        mesh->vertices.resize(header.vertices);
+        memcpy(mesh->vertices.data(), p, header.vertices * sizeof(vec3));
+        p += header.vertices * sizeof(vec3);
+        mesh->faces.resize(header.triangles * 3);
+        memcpy(mesh->faces.data(), p, header.triangles * 3 * sizeof(uint32_t));
+        for(auto v : mesh->faces)
+        {
+            if(v >= mesh->vertices.size())
+            {
+                delete mesh;
+                return nullptr;
+            }
+        }
+        return mesh;
+    }
+
+    bool TriangleMesh::saveBinary(const std::string &filename) const
+    {
+        return writeFile(filename, [&](std::ofstream &f)
+        {
+            writeBinary(f);
+        });
+    }
+
+    size_t TriangleMesh::binarySize() const
+    {
+        return sizeof(MeshFileHeader) + vertices.size() * sizeof(vec3) + faces.size() * sizeof(uint32_t);
+    }
+
+    void TriangleMesh::writeBinary(std::ostream &f) const
+    {
+        MeshFileHeader header;
+        memcpy(header.magic, MESH_FILE_MAGIC, sizeof(header.magic));
+        header.version = MESH_FILE_VERSION;
+        header.reserved = 0;
+        header.vertices = vertices.size();
+        header.triangles = size();
+        extents(header.bounds[0], header.bounds[1]);
+
+        f.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        f.write(reinterpret_cast<const char *>(vertices.data()), vertices.size() * sizeof(vec3));
+        f.write(reinterpret_cast<const char *>(faces.data()), faces.size() * sizeof(uint32_t));
+    }
+
+    uint32_t TriangleMesh::addVertex(const vec3 &v)
+    {
+        vertices.push_back(v);
+        return vertices.size() - 1;
+    }
+
+    void TriangleMesh::addFace(const uint32_t &a, const uint32_t &b, const uint32_t &c)
+    {
+        faces.push_back(a);
+        faces.push_back(b);
+        faces.push_back(c);
+        bvh.clear();
+        blocks.clear();
+    }
+
+    void TriangleMesh::addTriangle(const vec3 &a, const vec3 &b, const vec3 &c)
+    {
+        uint32_t i = addVertex(a);
+        addVertex(b);
+        addVertex(c);
+        addFace(i, i + 1, i + 2);
+    }
+
+    static float axisOf(const vec3 &v, const int &axis)
+    {
+        return axis == 0 ? v.x : axis == 1 ? v.y : v.z;
+    }
+
+    /**
+     * clipTriangle:
+     * -------------
+     * the bounds of the part of a triangle lying in the slab lo <= p[axis] <= hi.
+     */
+    static void clipTriangle(const vec3 *v[3], const int &axis, const float &lo, const float &hi, vec3 bounds[2])
+    {
+        float big = std::numeric_limits<float>::max();
+        bounds[0] = {big, big, big};
+        bounds[1] = {-big, -big, -big};
+        auto grow = [&](const vec3 &p)
+        {
+            bounds[0] = {std::min(bounds[0].x, p.x), std::min(bounds[0].y, p.y), std::min(bounds[0].z, p.z)};
+            bounds[1] = {std::max(bounds[1].x, p.x), std::max(bounds[1].y, p.y), std::max(bounds[1].z, p.z)};
+        };
+        for(int i = 0;i < 3;i++)
+        {
+            const vec3 &a = *v[i], &b = *v[(i + 1) % 3];
+            float pa = axisOf(a, axis), pb = axisOf(b, axis);
+            if(pa >= lo && pa <= hi)
+            {
+                grow(a);
+            }
+            // add the points where the edge crosses either plane of the slab.
+            for(float plane : {lo, hi})
+            {
+                if((pa < plane) != (pb < plane))
+                {
+                    grow(a + (b - a) * ((plane - pa) / (pb - pa)));
+                }
+            }
+        }
+    }
+
+    void TriangleMesh::build(const BVH::BuildMode &mode, const float &budget)
+    {
+        this->mode = mode;
+        this->budget = budget;
+        std::vector<BVHPrimitive> prims(size());
+        for(size_t i = 0;i < prims.size();i++)
+        {
+            Triangle(vertices[faces[3 * i]], vertices[faces[3 * i + 1]], vertices[faces[3 * i + 2]]).extents(prims[i].bounds[0], prims[i].bounds[1]);
+            prims[i].centroid = (prims[i].bounds[0] + prims[i].bounds[1]) / 2;
+        }
+        bvh.build(prims, mode, [this](const uint32_t &index, const int &axis, const float &lo, const float &hi, vec3 bounds[2])
+        {
+            const vec3 *v[3] = {&vertices[faces[3 * index]], &vertices[faces[3 * index + 1]], &vertices[faces[3 * index + 2]]};
+            clipTriangle(v, axis, lo, hi, bounds);
+        }, budget, TriangleBlock::WIDTH);
+        bvh.alignLeaves(TriangleBlock::WIDTH);
+        buildBlocks();
+    }
+
+    void TriangleMesh::buildBlocks()
+    {
+        blocks.assign(bvh.indices.size() / TriangleBlock::WIDTH, TriangleBlock());
+        for(const auto &node : bvh.nodes)
+        {
+            if(node.count == 0) continue;
+            TriangleBlock &block = blocks[node.offset / TriangleBlock::WIDTH];
+            for(int i = 0;i < node.count;i++)
+            {
+                const uint32_t *f = &faces[3 * bvh.indices[node.offset + i]];
+                block.set(i, vertices[f[0]], vertices[f[1]], vertices[f[2]]);
+            }
+        }
+    }
+
+    bool TriangleMesh::isBuilt(const BVH::BuildMode &mode, const float &budget) const
+    {
+        return !bvh.empty() && this->mode == mode && (mode != BVH::SPATIAL || this->budget == budget);
+    }
+
+    bool TriangleMesh::intersectFace(const uint32_t &face, const Ray &ray, float &t) const
+    {
+        const uint32_t *f = &faces[3 * face];
+        return raytriangle(ray, vertices[f[0]], vertices[f[1]], vertices[f[2]], t);
+    }
+
+    bool TriangleMesh::intersect(const Ray &ray, float &t) const
+    {
+        if(bvh.empty())
+        {
+            // not built yet, fall back to testing everything.
+            bool hit = false;
+            for(size_t i = 0;i < size();i++)
+            {
+                if(intersectFace(i, ray, t))
+                {
+                    hit = true;
+                }
+            }
+            return hit;
+        }
+        return bvh.traverse(ray, t, [this](const uint32_t &offset, const uint32_t &, const Ray &ray, float &t)
+        {
+            return raytriangles(ray, blocks[offset / TriangleBlock::WIDTH], t);
+        });
+    }
+
+    void TriangleMesh::intersectPacket(const RayPacket &packet, float *t) const
+    {
+        if(bvh.empty() || !packet.coherent)
+        {
+            for(int i = 0;i < packet.size;i++)
+            {
+                intersect(packet.rays[i], t[i]);
+            }
+            return;
+        }
+        bvh.traversePacket(packet, t, [this](const uint32_t &offset, const uint32_t &, const RayPacket &packet, float *t)
+        {
+            const TriangleBlock &block = blocks[offset / TriangleBlock::WIDTH];
+            for(int i = 0;i < packet.size;i++)
+            {
+                raytriangles(packet.rays[i], block, t[i]);
+            }
+        });
+    }
+
+    void TriangleMesh::extents(vec3 &emin, vec3 &emax) const
+    {
+        if(bvh.empty())
+        {
+            emin = emax = vertices.empty() ? vec3{0, 0, 0} : vertices[0];
+            for(const auto &v : vertices)
+            {
+                emin = {std::min(emin.x, v.x), std::min(emin.y, v.y), std::min(emin.z, v.z)};
+                emax = {std::max(emax.x, v.x), std::max(emax.y, v.y), std::max(emax.z, v.z)};
+            }
+            return;
+        }
+        emin = bvh.nodes[0].bounds[0];
+        emax = bvh.nodes[0].bounds[1];
+    }
+
+    size_t TriangleMesh::size() const
+    {
+        return faces.size() / 3;
+    }
+
+    Instance::Instance(const TriangleMesh *mesh, const mat4 &m):mesh(mesh)
+    {
+        setTransform(m);
+    }
+
+    void Instance::setMesh(const TriangleMesh *mesh)
+    {
+        this->mesh = mesh;
+        setTransform(toWorld);
+    }
+
+    void Instance::setTransform(const mat4 &m)
+    {
+        toWorld = m;
+        toObject = inverse(m);
+        vec3 emin, emax;
+        mesh->extents(emin, emax);
+        vec3 corners[2] = {emin, emax};
+        for(int i = 0;i < 8;i++)
+        {
+            vec3 p = transformPt(toWorld, {corners[i & 1].x, corners[(i >> 1) & 1].y, corners[(i >> 2) & 1].z});
+            if(i == 0)
+            {
+                bounds[0] = bounds[1] = p;
+            }
+            else
+            {
+                bounds[0] = {std::min(bounds[0].x, p.x), std::min(bounds[0].y, p.y), std::min(bounds[0].z, p.z)};
+                bounds[1] = {std::max(bounds[1].x, p.x), std::max(bounds[1].y, p.y), std::max(bounds[1].z, p.z)};
+            }
+        }
+    }
+
+    bool Instance::intersect(const Ray &ray, float &t) const
+    {
+        // the direction is not renormalized, so distances in object space match world space.
+        Ray local(transformPt(toObject, ray.orig), transformDir(toObject, ray.dir));
+        return mesh->intersect(local, t);
+    }
+
+    void Instance::intersectPacket(const RayPacket &packet, float *t) const
+    {
+        // a shared origin stays shared once moved into object space.
+        RayPacket local;
+        for(int i = 0;i < packet.size;i++)
+        {
+            const Ray &ray = packet.rays[i];
+            local.add(Ray(transformPt(toObject, ray.orig), transformDir(toObject, ray.dir)));
+        }
+        mesh->intersectPacket(local, t);
+    }
+
+    void Instance::extents(vec3 &emin, vec3 &emax) const
+    {
+        emin = bounds[0];
+        emax = bounds[1];
+    }
+};
@@ -0,0 +1,249 @@
+#ifndef __MESH_HPP__
+#define __MESH_HPP__
+
+#include "vec3.hpp"
+#include "mat4.hpp"
+#include "ray.hpp"
+#include "shape.hpp"
+#include "bvh.hpp"
+#include "triangles.hpp"
+#include "thread-pool.hpp"
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace rt
+{
+    /**
+     * TriangleMesh:
+     * -------------
+     * the triangles of one mesh in object space, together with the BVH built
+     * over them.  Triangles are three 32 bit indices into a vertex buffer
+     * shared by the whole mesh, and are intersected by index from the BVH
+     * leaves.  A mesh is loaded and built once, then shared by every Instance
+     * that places it in the scene, and is not changed once it is shared.
+     */
+    class TriangleMesh
+    {
+    public:
+        TriangleMesh();
+
+        /**
+         * FromObj:
+         * --------
+         * loads the triangles of an obj file.
+         * NOTE: build needs to be called before the mesh is traced.
+         *
+         * @param filename: string the name of the obj file.
+         * @param pool: ThreadPool the threads to parse the file with.
+         * @return the mesh, or nullptr if the file could not be loaded.
+         */
+        static TriangleMesh *FromObj(const std::string &filename, ThreadPool &pool);
+
+        /**
+         * FromCache:
+         * ----------
+         * loads a mesh along with its built BVH from a file written by save.
+         *
+         * @param filename: string the name of the cache file.
+         * @param key: uint64_t the key the file has to have been saved with.
+         * @param sourceSize: uint64_t the size of the source file the mesh has to have been saved from.
+         * @return the mesh, or nullptr if the file is missing, stale or damaged.
+         */
+        static TriangleMesh *FromCache(const std::string &filename, const uint64_t &key, const uint64_t &sourceSize);
+
+        /**
+         * save:
+         * -----
+         * writes the triangles and BVH of a built mesh to a cache file.  The
+         * file is a header followed by the raw vertex, face, node and index arrays,
+         * so loading it is a single mapping and copy.
+         *
+         * @param filename: string the name of the cache file.
+         * @param key: uint64_t identifies the source of the mesh, checked by FromCache.
+         * @param sourceSize: uint64_t the size of the source file, also checked by FromCache.
+         * @return true if the file was written, false otherwise.
+         */
+        bool save(const std::string &filename, const uint64_t &key, const uint64_t &sourceSize) const;
+
+        /**
+         * FromBinary:
+         * -----------
+         * loads the triangles of a binary mesh file written by saveBinary.  The
+         * file is mapped and its arrays copied into the mesh, with no parsing.
+         * NOTE: build needs to be called before the mesh is traced.
+         *
+         * @param filename: string the name of the binary mesh file.
+         * @return the mesh, or nullptr if the file could not be loaded or is damaged.
+         */
+        static TriangleMesh *FromBinary(const std::string &filename);
+
+        /**
+         * FromBinary:
+         * -----------
+         * loads the triangles of a binary mesh already in memory, such as one
+         * stored inside a compiled scene.
+         *
+         * @param data: char* the start of the binary mesh.
+         * @param size: size_t the number of bytes in it.
+         * @return the mesh, or nullptr if it is damaged.
+         */
+        static TriangleMesh *FromBinary(const char *data, const size_t &size);
+
+        /**
+         * saveBinary:
+         * -----------
+         * writes the triangles of the mesh to a binary mesh file: a header with
+         * the counts and bounds, then the float vertex array and the uint32
+         * index array, in native byte order.
+         *
+         * @param filename: string the name of the binary mesh file, conventionally ending in BINARY_EXTENSION.
+         * @return true if the file was written, false otherwise.
+         */
+        bool saveBinary(const std::string &filename) const;
+
+        /**
+         * writeBinary:
+         * ------------
+         * writes the triangles of the mesh to a stream in the binary mesh format
+         * of saveBinary, taking binarySize bytes.
+         */
+        void writeBinary(std::ostream &f) const;
+        size_t binarySize() const;
+
+        // the extension of binary mesh files, which the obj directive loads with FromBinary.
+        static constexpr const char *BINARY_EXTENSION = ".bmesh";
+
+        /**
+         * addVertex:
+         * ----------
+         * adds a vertex to the shared vertex buffer.
+         *
+         * @return the index of the vertex.
+         */
+        uint32_t addVertex(const vec3 &v);
+
+        /**
+         * addFace:
+         * --------
+         * adds a triangle over three vertices already in the mesh.
+         * NOTE: build needs to be called once all the triangles have been added.
+         */
+        void addFace(const uint32_t &a, const uint32_t &b, const uint32_t &c);
+
+        /**
+         * addTriangle:
+         * ------------
+         * adds a triangle with its own three vertices to the mesh.
+         * NOTE: build needs to be called once all the triangles have been added.
+         */
+        void addTriangle(const vec3 &a, const vec3 &b, const vec3 &c);
+
+        /**
+         * build:
+         * ------
+         * builds the BVH and packs the triangles of every leaf into a block.
+         *
+         * @param mode: BuildMode the BVH builder to use.
+         * @param budget: float extra triangle references a spatial build may add, as a fraction of the triangle count.
+         */
+        void build(const BVH::BuildMode &mode=BVH::SAH, const float &budget=BVH::DEFAULT_SPLIT_BUDGET);
+
+        // whether the mesh was built as build(mode, budget) would, the budget only matters to spatial builds.
+        bool isBuilt(const BVH::BuildMode &mode, const float &budget) const;
+
+        /**
+         * intersect:
+         * ----------
+         * performs an intersection test between the mesh and an object space ray.
+         *
+         * @param ray: Ray the incoming ray in object space.
+         * @param t: float the distance from the ray origin to the intersection point.
+         * @return true if hit, false otherwise.
+         */
+        bool intersect(const Ray &ray, float &t) const;
+
+        /**
+         * intersectPacket:
+         * ----------------
+         * intersects every ray of an object space packet with the mesh.
+         *
+         * @param packet: RayPacket the incoming rays in object space.
+         * @param t: float[] the distance to the closest intersection so far of each ray.
+         */
+        void intersectPacket(const RayPacket &packet, float *t) const;
+        void extents(vec3 &emin, vec3 &emax) const;
+        size_t size() const;
+    private:
+        bool intersectFace(const uint32_t &face, const Ray &ray, float &t) const;
+        void buildBlocks();
+
+        std::vector<vec3> vertices;
+        std::vector<uint32_t> faces;    // three consecutive vertex indices per triangle
+        BVH bvh;
+        std::vector<TriangleBlock> blocks;  // the triangles of the leaf starting at bvh index i are in block i / WIDTH
+        BVH::BuildMode mode;
+        float budget;
+    };
+
+    /**
+     * Instance:
+     * ---------
+     * a shape placing a shared mesh in the scene with its own transformation.
+     * Rays are moved into the object space of the mesh rather than the mesh
+     * being copied into world space.
+     */
+    class Instance: public Shape
+    {
+    public:
+        /**
+         * Instance:
+         * ---------
+         * constructs a new instance of a mesh.
+         *
+         * @param mesh: TriangleMesh* the built mesh to place.
+         * @param m: mat4 the object to world transformation.
+         */
+        Instance(const TriangleMesh *mesh, const mat4 &m);
+
+        virtual bool intersect(const Ray &ray, float &t) const;
+        virtual void extents(vec3 &emin, vec3 &emax) const;
+
+        /**
+         * intersectPacket:
+         * ----------------
+         * moves a packet into the object space of the mesh and intersects it.
+         *
+         * @param packet: RayPacket the incoming rays.
+         * @param t: float[] the distance to the closest intersection so far of each ray.
+         */
+        void intersectPacket(const RayPacket &packet, float *t) const;
+
+        /**
+         * setTransform:
+         * -------------
+         * moves the instance, the shared mesh is left untouched.
+         * NOTE: the scene needs to be refit before it is traced again.
+         *
+         * @param m: mat4 the new object to world transformation.
+         */
+        void setTransform(const mat4 &m);
+
+        /**
+         * setMesh:
+         * --------
+         * places another build of the same triangles, such as one for another BVH build mode.
+         *
+         * @param mesh: TriangleMesh* the built mesh to place instead.
+         */
+        void setMesh(const TriangleMesh *mesh);
+    private:
+        const TriangleMesh *mesh;
+        mat4 toWorld, toObject;
+        vec3 bounds[2];
+    };
+
+}; // namespace
+
+#endif // __MESH_HPP__
@@ -0,0 +1,195 @@
+#include "obj-loader.hpp"
+#include "mapped-file.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+
+namespace rt
+{
+    // files are split into chunks of at least this many bytes, a few per thread.
+    static constexpr size_t MIN_CHUNK_SIZE = 1 << 20;
+    static constexpr size_t CHUNKS_PER_THREAD = 4;
+
+    /**
+     * ObjChunk:
+     * ---------
+     * a line aligned range of an obj file, along with how many vertices and
+     * triangles it holds, where they go in the output, and the first line
+     * that could not be parsed.
+     */
+    struct ObjChunk
+    {
+        const char *begin, *end;
+        size_t vertices, triangles;
+        size_t firstVertex, firstTriangle;
+        const char *error;
+    };
+
+    static bool isSpace(const char &c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    static const char *skipSpace(const char *p, const char *end)
+    {
+        while(p < end && isSpace(*p)) p++;
+        return p;
+    }
+
+    static const char *nextLine(const char *p, const char *end)
+    {
+        const char *newline = static_cast<const char *>(memchr(p, '\n', end - p));
+        return newline ? newline + 1 : end;
+    }
+
+    static const char *parseFloat(const char *p, const char *end, float &f)
+    {
+        p = skipSpace(p, end);
+        // from_chars takes no leading plus.
+        if(p < end && *p == '+') p++;
+        auto result = std::from_chars(p, end, f);
+        return result.ec == std::errc() ? result.ptr : nullptr;
+    }
+
+    /**
+     * parseChunk:
+     * -----------
+     * walks the lines of a chunk.  Counting only finds the number of vertices
+     * and triangles; otherwise they are parsed into their place in the output.
+     *
+     * @return false if a line is malformed or a face refers to a vertex not
+     *         defined before it, with chunk.error set to the start of the line.
+     */
+    template<bool COUNT>
+    static bool parseChunk(ObjChunk &chunk, vec3 *vertices, uint32_t *faces)
+    {
+        size_t v = 0, triangles = 0;
+        const char *p = chunk.begin, *end = chunk.end;
+        while(p < end)
+        {
+            const char *line = p;
+            p = skipSpace(p, end);
+            if(end - p >= 2 && p[0] == 'v' && isSpace(p[1]))
+            {
+                if(!COUNT)
+                {
+                    vec3 &vertex = vertices[chunk.firstVertex + v];
+                    p += 2;
+                    if(!(p = parseFloat(p, end, vertex.x)) || !(p = parseFloat(p, end, vertex.y)) || !(p = parseFloat(p, end, vertex.z)))
+                    {
+                        chunk.error = line;
+                        return false;
+                    }
+                }
+                v++;
+            }
+            else if(end - p >= 2 && p[0] == 'f' && isSpace(p[1]))
+            {
+                p += 2;
+                uint32_t first = 0, previous = 0;
+                size_t corners = 0;
+                while(true)
+                {
+                    p = skipSpace(p, end);
+                    if(p == end || *p == '\n' || *p == '#') break;
+                    uint32_t index = 0;
+                    if(!COUNT)
+                    {
+                        long long i;
+                        auto result = std::from_chars(p, end, i);
+                        // indices count from 1, negative ones back from the latest vertex.
+                        size_t defined = chunk.firstVertex + v;
+                        long long resolved = i > 0 ? i - 1 : static_cast<long long>(defined) + i;
+                        if(result.ec != std::errc() || i == 0 || resolved < 0 || static_cast<size_t>(resolved) >= defined)
+                        {
+                            chunk.error = line;
+                            return false;
+                        }
+                        p = result.ptr;
+                        index = resolved;
+                    }
+                    // skip the texture and normal indices.
+                    while(p < end && !isSpace(*p) && *p != '\n') p++;
+
+                    if(corners == 0)
+                    {
+                        first = index;
+                    }
+                    else if(corners >= 2)
+                    {
+                        if(!COUNT)
+                        {
+                            uint32_t *face = &faces[3 * (chunk.firstTriangle + triangles)];
+                            face[0] = first;
+                            face[1] = previous;
+                            face[2] = index;
+                        }
+                        triangles++;
+                    }
+                    previous = index;
+                    corners++;
+                }
+            }
+            p = nextLine(p, end);
+        }
+        chunk.vertices = v;
+        chunk.triangles = triangles;
+        return true;
+    }
+
+    bool loadObj(const std::string &filename, std::vector<vec3> &vertices, std::vector<uint32_t> &faces, ThreadPool &pool)
+    {
+        MappedFile file;
+        if(!file.open(filename))
+        {
+            std::cerr << "Error reading obj: " << filename << std::endl;
+            return false;
+        }
+        const char *data = file.data(), *end = data + file.size();
+
+        size_t count = std::max<size_t>(1, std::min(pool.size() * CHUNKS_PER_THREAD, file.size() / MIN_CHUNK_SIZE));
+        std::vector<ObjChunk> chunks(count);
+        const char *begin = data;
+        for(size_t c = 0;c < count;c++)
+        {
+            // move every split point to the start of the following line.
+            const char *split = c + 1 < count ? nextLine(data + file.size() * (c + 1) / count, end) : end;
+            split = std::max(split, begin);
+            chunks[c] = {begin, split, 0, 0, 0, 0, nullptr};
+            begin = split;
+        }
+
+        pool.parallelFor(count, [&](size_t c)
+        {
+            parseChunk<true>(chunks[c], nullptr, nullptr);
+        });
+        size_t vertexCount = 0, triangleCount = 0;
+        for(auto &chunk : chunks)
+        {
+            chunk.firstVertex = vertexCount;
+            chunk.firstTriangle = triangleCount;
+            vertexCount += chunk.vertices;
+            triangleCount += chunk.triangles;
+        }
+
+        vertices.resize(vertexCount);
+        faces.resize(3 * triangleCount);
+        pool.parallelFor(count, [&](size_t c)
+        {
+            parseChunk<false>(chunks[c], vertices.data(), faces.data());
+        });
+        for(const auto &chunk : chunks)
+        {
+            if(chunk.error != nullptr)
+            {
+                std::cerr << "Error parsing obj: " << filename << ":" << std::count(data, chunk.error, '\n') + 1 << std::endl;
+                vertices.clear();
+                faces.clear();
+                return false;
+            }
+        }
+        return true;
+    }
+};
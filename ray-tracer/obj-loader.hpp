@@ -0,0 +1,32 @@
+#ifndef __OBJ_LOADER_HPP__
+#define __OBJ_LOADER_HPP__
+
+#include "vec3.hpp"
+#include "thread-pool.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace rt
+{
+    /**
+     * loadObj:
+     * --------
+     * reads the vertex positions and faces of an obj file.  The file is
+     * mapped into memory, split into line aligned chunks and parsed on the
+     * threads of a pool: a first pass counts the vertices and triangles of
+     * every chunk, a second one parses each chunk straight into its place in
+     * the output.  Polygons are split into triangle fans; texture coordinates,
+     * normals, groups and materials are skipped.
+     *
+     * @param filename: string the name of the obj file.
+     * @param vertices: vector<vec3> set to the vertex positions.
+     * @param faces: vector<uint32_t> set to three vertex indices per triangle.
+     * @param pool: ThreadPool the threads to parse with, shared with the caller's other work.
+     * @return true if the file was read, false if it could not be opened or is malformed.
+     */
+    bool loadObj(const std::string &filename, std::vector<vec3> &vertices, std::vector<uint32_t> &faces, ThreadPool &pool);
+};
+
+#endif // __OBJ_LOADER_HPP__
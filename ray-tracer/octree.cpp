@@ -0,0 +1,158 @@
+#include "octree.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace rt
+{
+    constexpr size_t Mailbox::SIZE;
+    constexpr size_t Mailbox::PROBES;
+    constexpr uint32_t Mailbox::EMPTY;
+
+    Mailbox::Mailbox()
+    {
+        memset(slots, 0xff, sizeof(slots));
+    }
+
+    bool Mailbox::insert(const uint32_t &index)
+    {
+        size_t h = (index * 2654435761u) % SIZE;
+        for(size_t i = 0;i < PROBES;i++)
+        {
+            uint32_t &slot = slots[(h + i) % SIZE];
+            if(slot == index) return false;
+            if(slot == EMPTY)
+            {
+                slot = index;
+                return true;
+            }
+        }
+        return true;
+    }
+
+    constexpr size_t OctreeNode::MAX_SIZE;
+    constexpr size_t OctreeNode::MAX_DEPTH;
+    constexpr size_t OctreeNode::MAX_COPIES;
+    constexpr size_t OctreeNode::MAX_REFERENCES;
+
+    OctreeNode::OctreeNode(const vec3 &emin, const vec3 &emax, size_t depth):depth(depth)
+    {
+        center = (emin + emax) / 2;
+        bounds[0] = emin;
+        bounds[1] = emax;
+    }
+
+    void OctreeNode::split(const std::vector<vec3> &boxes, size_t &references, const size_t &maxReferences)
+    {
+        if(content.size() < MAX_SIZE || depth >= MAX_DEPTH)
+        {
+            return;
+        }
+
+        // child c lies on the upper side of the centre along x, y and z when bits 0, 1 and 2 of c are set.
+        std::vector<uint32_t> parts[8];
+        for(auto index : content)
+        {
+            const vec3 &smin = boxes[2 * index], &smax = boxes[2 * index + 1];
+            bool lower[3] = {smin.x < center.x, smin.y < center.y, smin.z < center.z};
+            bool upper[3] = {smax.x >= center.x, smax.y >= center.y, smax.z >= center.z};
+            for(int c = 0;c < 8;c++)
+            {
+                if((c & 1 ? upper[0] : lower[0]) && (c & 2 ? upper[1] : lower[1]) && (c & 4 ? upper[2] : lower[2]))
+                {
+                    parts[c].push_back(index);
+                }
+            }
+        }
+        size_t largest = 0, total = 0;
+        for(const auto &part : parts)
+        {
+            largest = std::max(largest, part.size());
+            total += part.size();
+        }
+        if(largest >= content.size() || total > MAX_COPIES * content.size() || references + total - content.size() > maxReferences)
+        {
+            return;
+        }
+        references += total - content.size();
+
+        children.reserve(8);
+        for(int c = 0;c < 8;c++)
+        {
+            vec3 emin = {c & 1 ? center.x : bounds[0].x, c & 2 ? center.y : bounds[0].y, c & 4 ? center.z : bounds[0].z};
+            vec3 emax = {c & 1 ? bounds[1].x : center.x, c & 2 ? bounds[1].y : center.y, c & 4 ? bounds[1].z : center.z};
+            children.push_back(OctreeNode(emin, emax, depth + 1));
+            children.back().content = std::move(parts[c]);
+        }
+        // only leaves hold shapes.
+        content.clear();
+        content.shrink_to_fit();
+        for(auto &child : children)
+        {
+            child.split(boxes, references, maxReferences);
+        }
+    }
+
+    OctreeContainer::OctreeContainer():root({0, 0, 0}, {0, 0, 0}, 0), built(false)
+    {}
+
+    bool OctreeContainer::intersect(const Ray &ray, float &t) const
+    {
+        if(!built)
+        {
+            // not built yet, fall back to testing everything.
+            bool hit = false;
+            for(auto s : shapes)
+            {
+                if(s->intersect(ray, t))
+                {
+                    hit = true;
+                }
+            }
+            return hit;
+        }
+        float tmin, tmax;
+        if(!raybox(ray, root.bounds, tmin, tmax) || tmax < 0 || tmin > t) return false;
+        Mailbox mailbox;
+        return root.intersect(ray, t, mailbox, [this](const uint32_t &i, const Ray &ray, float &t)
+        {
+            return primitives.intersect(primitives.refs[i], ray, t);
+        });
+    }
+
+    void OctreeContainer::addShape(Shape *shape)
+    {
+        shapes.push_back(shape);
+        built = false;
+    }
+
+    size_t OctreeContainer::size() const
+    {
+        return shapes.size();
+    }
+
+    void OctreeContainer::build()
+    {
+        if(shapes.empty()) return;
+        std::vector<vec3> boxes(2 * shapes.size());
+        shapes[0]->extents(boxes[0], boxes[1]);
+        vec3 emin = boxes[0], emax = boxes[1];
+        for(size_t i = 1;i < shapes.size();i++)
+        {
+            vec3 &smin = boxes[2 * i], &smax = boxes[2 * i + 1];
+            shapes[i]->extents(smin, smax);
+            emin = {std::min(emin.x, smin.x), std::min(emin.y, smin.y), std::min(emin.z, smin.z)};
+            emax = {std::max(emax.x, smax.x), std::max(emax.y, smax.y), std::max(emax.z, smax.z)};
+        }
+        primitives.assign(shapes);
+        root = OctreeNode(emin, emax, 0);
+        root.content.resize(shapes.size());
+        for(size_t i = 0;i < shapes.size();i++)
+        {
+            root.content[i] = i;
+        }
+        size_t references = shapes.size();
+        root.split(boxes, references, OctreeNode::MAX_REFERENCES * shapes.size());
+        built = true;
+    }
+};
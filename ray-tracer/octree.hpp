@@ -0,0 +1,162 @@
+#ifndef __OCTREE_HPP__
+#define __OCTREE_HPP__
+
+#include "vec3.hpp"
+#include "ray.hpp"
+#include "shape.hpp"
+#include "primitives.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace rt
+{
+    /**
+     * Mailbox:
+     * --------
+     * remembers which primitives a single ray has already been tested against,
+     * so primitives that straddle several cells are only tested once.  It lives
+     * on the stack of the traversal, which keeps it safe to share a container
+     * between threads.
+     */
+    struct Mailbox
+    {
+        static constexpr size_t SIZE = 128;
+        static constexpr size_t PROBES = 8;
+        static constexpr uint32_t EMPTY = 0xffffffff;
+        uint32_t slots[SIZE];
+
+        Mailbox();
+
+        /**
+         * insert:
+         * -------
+         * records that a primitive is about to be tested.
+         *
+         * @param index: uint32_t the primitive index.
+         * @return false if the primitive has already been tested by this ray.
+         * NOTE: when the mailbox is full this returns true, so a primitive may be retested but never skipped.
+         */
+        bool insert(const uint32_t &index);
+    };
+
+    /**
+     * OctreeNode:
+     * -----------
+     * a cell of an octree holding the indices of the shapes that overlap it.
+     */
+    struct OctreeNode
+    {
+        static constexpr size_t MAX_SIZE = 5;
+        static constexpr size_t MAX_DEPTH = 8;
+        // a split may hand its children at most this many references per shape of the cell.
+        static constexpr size_t MAX_COPIES = 4;
+        // the whole tree holds at most this many references per shape.
+        static constexpr size_t MAX_REFERENCES = 8;
+        vec3 center;
+        std::vector<uint32_t> content;
+        std::vector<OctreeNode> children;
+        vec3 bounds[2];
+        size_t depth;
+        OctreeNode(const vec3 &emin, const vec3 &emax, size_t depth);
+
+        /**
+         * split:
+         * ------
+         * splits the cell into eight children, and them in turn, for as long as
+         * it pays.  A shape goes to the children on each side of the centre it
+         * reaches past, with a half open test, so shapes lying on a centre plane
+         * go to one side only.  A cell stays a leaf when no child would hold
+         * fewer shapes than it does, or when the copies of straddling shapes
+         * would take more than the allowed references.
+         *
+         * @param boxes: vector the extents of every shape, two vec3's each.
+         * @param references: size_t the references held by the whole tree, updated.
+         * @param maxReferences: size_t the most references the whole tree may hold.
+         */
+        void split(const std::vector<vec3> &boxes, size_t &references, const size_t &maxReferences);
+
+        /**
+         * intersect:
+         * ----------
+         * visits the cells the ray passes through in the order the ray reaches
+         * them, and stops as soon as the next cell starts past the closest hit.
+         *
+         * @param ray: Ray the incoming ray.
+         * @param t: float the distance to the closest intersection so far.
+         * @param mailbox: Mailbox the primitives already tested by this ray.
+         * @param leaf: callable (uint32_t index, const Ray &ray, float &t) -> bool.
+         * @return true if any primitive was hit, false otherwise.
+         */
+        template<typename Leaf>
+        bool intersect(const Ray &ray, float &t, Mailbox &mailbox, Leaf &&leaf) const;
+    };
+
+    /**
+     * OctreeContainer:
+     * ----------------
+     * a shape container backed by an octree, best suited to dense scenes with
+     * evenly distributed shapes.
+     */
+    class OctreeContainer: public ShapeContainer
+    {
+    public:
+        OctreeContainer();
+        virtual bool intersect(const Ray &ray, float &t) const;
+        virtual void addShape(Shape *shape);
+        virtual size_t size() const;
+        virtual void build();
+    private:
+        std::vector<Shape*> shapes;
+        PrimitiveSet primitives;
+        OctreeNode root;
+        bool built;
+    };
+
+    template<typename Leaf>
+    bool OctreeNode::intersect(const Ray &ray, float &t, Mailbox &mailbox, Leaf &&leaf) const
+    {
+        bool hit = false;
+        if(children.size() == 0)
+        {
+            for(auto index : content)
+            {
+                if(mailbox.insert(index) && leaf(index, ray, t))
+                {
+                    hit = true;
+                }
+            }
+            return hit;
+        }
+
+        // a ray can pass through at most four of the eight children.
+        const OctreeNode *order[8];
+        float entry[8];
+        int count = 0;
+        for(const auto &child : children)
+        {
+            float tmin, tmax;
+            if(!raybox(ray, child.bounds, tmin, tmax) || tmax < 0 || tmin > t) continue;
+            int i = count++;
+            for(;i > 0 && entry[i - 1] > tmin;i--)
+            {
+                order[i] = order[i - 1];
+                entry[i] = entry[i - 1];
+            }
+            order[i] = &child;
+            entry[i] = tmin;
+        }
+        for(int i = 0;i < count && entry[i] <= t;i++)
+        {
+            if(order[i]->intersect(ray, t, mailbox, leaf))
+            {
+                hit = true;
+            }
+        }
+        return hit;
+    }
+
+}; // namespace
+
+#endif // __OCTREE_HPP__
@@ -0,0 +1,88 @@
+#include "primitives.hpp"
+#include "mesh.hpp"
+
+namespace rt
+{
+    constexpr uint32_t PrimitiveSet::TYPE_SHIFT;
+    constexpr uint32_t PrimitiveSet::INDEX_MASK;
+
+    uint32_t PrimitiveSet::add(const Shape *shape)
+    {
+        // the boxes wrapping a shape are redundant once it sits in a container.
+        while(auto box = dynamic_cast<const BoundingBox*>(shape))
+        {
+            shape = box->getShape();
+        }
+        uint32_t ref;
+        if(auto sphere = dynamic_cast<const Sphere*>(shape))
+        {
+            ref = (SPHERE << TYPE_SHIFT) | centers.size();
+            centers.push_back(sphere->getCenter());
+            radii2.push_back(sphere->getRadius() * sphere->getRadius());
+        }
+        else if(auto triangle = dynamic_cast<const Triangle*>(shape))
+        {
+            ref = (TRIANGLE << TYPE_SHIFT) | (triangles.size() / 3);
+            for(int i = 0;i < 3;i++)
+            {
+                triangles.push_back(triangle->vertex(i));
+            }
+        }
+        else if(auto instance = dynamic_cast<const Instance*>(shape))
+        {
+            ref = (INSTANCE << TYPE_SHIFT) | instances.size();
+            instances.push_back(instance);
+        }
+        else
+        {
+            ref = (SHAPE << TYPE_SHIFT) | shapes.size();
+            shapes.push_back(shape);
+        }
+        refs.push_back(ref);
+        return ref;
+    }
+
+    void PrimitiveSet::assign(const std::vector<Shape*> &shapes)
+    {
+        clear();
+        refs.reserve(shapes.size());
+        for(auto s : shapes)
+        {
+            add(s);
+        }
+    }
+
+    void PrimitiveSet::clear()
+    {
+        refs.clear();
+        centers.clear();
+        radii2.clear();
+        triangles.clear();
+        instances.clear();
+        shapes.clear();
+    }
+
+    size_t PrimitiveSet::size() const
+    {
+        return refs.size();
+    }
+
+    void PrimitiveSet::intersectPacket(const uint32_t &ref, const RayPacket &packet, float *t) const
+    {
+        if(ref >> TYPE_SHIFT == INSTANCE)
+        {
+            instances[ref & INDEX_MASK]->intersectPacket(packet, t);
+            return;
+        }
+        for(int i = 0;i < packet.size;i++)
+        {
+            intersect(ref, packet.rays[i], t[i]);
+        }
+    }
+
+    bool PrimitiveSet::intersectInstance(const uint32_t &index, const Ray &ray, float &t) const
+    {
+        // qualified, so the call is bound here rather than through the vtable.
+        return instances[index]->Instance::intersect(ray, t);
+    }
+};
@@ -0,0 +1,103 @@
+#ifndef __PRIMITIVES_HPP__
+#define __PRIMITIVES_HPP__
+
+#include "vec3.hpp"
+#include "ray.hpp"
+#include "shape.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace rt
+{
+    class Instance;
+
+    /**
+     * PrimitiveSet:
+     * -------------
+     * the shapes of a container copied into one contiguous array per shape
+     * type.  Each shape gets a reference holding its type in the top bits and
+     * its slot in that type's array below, so containers test primitives by a
+     * switch on the type rather than a virtual call through Shape.  Shapes of
+     * types without an array of their own are kept as Shape pointers.
+     */
+    class PrimitiveSet
+    {
+    public:
+        enum Type {SPHERE, TRIANGLE, INSTANCE, SHAPE};
+        static constexpr uint32_t TYPE_SHIFT = 30;
+        static constexpr uint32_t INDEX_MASK = (1u << TYPE_SHIFT) - 1;
+
+        /**
+         * add:
+         * ----
+         * copies a shape into the array of its type.
+         *
+         * @param shape: Shape* the shape to add.
+         * @return the reference of the shape.
+         */
+        uint32_t add(const Shape *shape);
+
+        /**
+         * assign:
+         * -------
+         * replaces the contents with the given shapes, so refs[i] refers to shapes[i].
+         */
+        void assign(const std::vector<Shape*> &shapes);
+        void clear();
+        size_t size() const;
+
+        /**
+         * intersect:
+         * ----------
+         * performs an intersection test between a primitive and a ray.
+         *
+         * @param ref: uint32_t the reference of the primitive.
+         * @param ray: Ray the incoming ray.
+         * @param t: float the distance to the closest intersection so far, updated on a closer hit.
+         * @return true if hit, false otherwise.
+         */
+        bool intersect(const uint32_t &ref, const Ray &ray, float &t) const;
+
+        /**
+         * intersectPacket:
+         * ----------------
+         * intersects a primitive with every ray of a packet.  Mesh instances
+         * carry coherent packets on into their own BVH.
+         *
+         * @param ref: uint32_t the reference of the primitive.
+         * @param packet: RayPacket the incoming rays.
+         * @param t: float[] the distance to the closest intersection so far of each ray.
+         */
+        void intersectPacket(const uint32_t &ref, const RayPacket &packet, float *t) const;
+
+        std::vector<uint32_t> refs;     // the reference of every shape, in the order they were added
+    private:
+        bool intersectInstance(const uint32_t &index, const Ray &ray, float &t) const;
+
+        std::vector<vec3> centers;      // spheres
+        std::vector<float> radii2;
+        std::vector<vec3> triangles;    // three consecutive vertices per triangle
+        std::vector<const Instance*> instances;
+        std::vector<const Shape*> shapes;
+    };
+
+    inline bool PrimitiveSet::intersect(const uint32_t &ref, const Ray &ray, float &t) const
+    {
+        uint32_t index = ref & INDEX_MASK;
+        switch(ref >> TYPE_SHIFT)
+        {
+            case SPHERE:
+                return raysphere(ray, centers[index], radii2[index], t);
+            case TRIANGLE:
+                return raytriangle(ray, triangles[3 * index], triangles[3 * index + 1], triangles[3 * index + 2], t);
+            case INSTANCE:
+                return intersectInstance(index, ray, t);
+            default:
+                return shapes[index]->intersect(ray, t);
+        }
+    }
+
+}; // namespace
+
+#endif // __PRIMITIVES_HPP__
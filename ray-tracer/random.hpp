@@ -0,0 +1,76 @@
+#ifndef __RANDOM_HPP__
+#define __RANDOM_HPP__
+
+#include <cstdint>
+
+namespace rt
+{
+    /**
+     * mix64:
+     * ------
+     * the finalizer of splitmix64, a bijective hash that spreads every input
+     * bit over the whole output.
+     */
+    constexpr uint64_t mix64(uint64_t x)
+    {
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        return x ^ (x >> 31);
+    }
+
+    /**
+     * Random:
+     * -------
+     * a counter based random number generator.  The n-th number of a stream
+     * is a hash of the stream's key and n, so there is no shared state to
+     * guard between threads, and a stream keyed by (seed, pixel, sample,
+     * bounce) gives the same numbers whichever thread draws them and in
+     * whatever order the pixels are traced.
+     */
+    class Random
+    {
+    public:
+        /**
+         * Random:
+         * -------
+         * starts the stream of numbers for one key.
+         *
+         * @param seed: uint64_t the seed of the whole render.
+         * @param pixel: uint64_t the index of the pixel.
+         * @param sample: uint64_t the sample within the pixel.
+         * @param bounce: uint64_t the bounce along the path of the sample.
+         */
+        explicit Random(const uint64_t &seed, const uint64_t &pixel=0, const uint64_t &sample=0, const uint64_t &bounce=0):
+            key(mix64(mix64(mix64(mix64(seed) ^ pixel) ^ sample) ^ bounce)), counter(0)
+        {}
+
+        uint32_t next()
+        {
+            return static_cast<uint32_t>(mix64(key + ++counter * 0x9E3779B97F4A7C15ull) >> 32);
+        }
+
+        /**
+         * uniform:
+         * --------
+         * @return a number drawn uniformly from [0, 1).
+         */
+        float uniform()
+        {
+            return (next() >> 8) * 0x1p-24f;
+        }
+
+        /**
+         * uniform:
+         * --------
+         * @return a number drawn uniformly from [rmin, rmax).
+         */
+        float uniform(const float &rmin, const float &rmax)
+        {
+            return rmin + (rmax - rmin) * uniform();
+        }
+    private:
+        uint64_t key, counter;
+    };
+};
+
+#endif // __RANDOM_HPP__
@@ -1,30 +1,68 @@
 #include "ray-tracer.hpp"
 
 
-float * trace_scene_raw(const std::string &filename, int &width, int &height, bool invert, bool verbosity, std::function<void(int, int)> callback)
+// loads a scene file, with the threads it names overridden unless threads is 0.
+static rt::RayTracingScene load_scene(const std::string &filename, bool verbosity, int threads)
 {
     rt::RayTracingScene scene = rt::RayTracingScene::FromScene(filename);
     scene.setVerbosity(verbosity);
+    if(threads > 0)
+    {
+        scene.setThreads(threads);
+    }
+    return scene;
+}
+
+float * trace_scene_raw(const std::string &filename, int &width, int &height, bool invert, bool verbosity, std::function<void(int, int)> callback, int threads, bool normalized)
+{
+    rt::RayTracingScene scene = load_scene(filename, verbosity, threads);
     float *pix = scene.getDistances(callback);
     int size = scene.getDims();
-    pix = rt::normalize(pix, size, invert);
+    if(normalized)
+    {
+        pix = rt::normalize(pix, size, invert);
+    }
     width = scene.getWidth();
     height = scene.getHeight();
     return pix;
 }
 
-float * trace_scene_raw(const std::string &filename, bool invert, bool verbosity, std::function<void(int, int)> callback)
+float * trace_scene_raw(const std::string &filename, bool invert, bool verbosity, std::function<void(int, int)> callback, int threads, bool normalized)
 {
     int width, height;
-    return trace_scene_raw(filename, width, height, invert, verbosity, callback);
+    return trace_scene_raw(filename, width, height, invert, verbosity, callback, threads, normalized);
 }
 
-cv::Mat trace_scene(const std::string &filename, bool invert, bool verbosity, std::function<void(int, int)> callback)
+cv::Mat trace_scene(const std::string &filename, bool invert, bool verbosity, std::function<void(int, int)> callback, int threads, bool normalized)
 {
-    int width, height;
-    float *pix = trace_scene_raw(filename, width, height, invert, verbosity, callback);
-    cv::Mat im(height, width, CV_32FC1, pix);
-    cv::Mat res = im.clone();
-    delete [] pix;
-    return res;
+    cv::Mat im;
+    trace_scene(filename, im, invert, verbosity, callback, threads, normalized);
+    return im;
+}
+
+bool trace_scene_raw(const std::string &filename, float *pix, int width, int height, size_t stride, bool invert, bool verbosity, std::function<void(int, int)> callback, int threads, bool normalized)
+{
+    rt::RayTracingScene scene = load_scene(filename, verbosity, threads);
+    if(scene.getWidth() != width || scene.getHeight() != height)
+    {
+        std::cerr << "Scene is " << scene.getWidth() << "x" << scene.getHeight() << ", not " << width << "x" << height << ": " << filename << std::endl;
+        return false;
+    }
+    scene.getDistances(pix, stride, callback);
+    if(normalized)
+    {
+        rt::normalize(pix, width, height, stride, invert);
+    }
+    return true;
+}
+
+void trace_scene(const std::string &filename, cv::Mat &im, bool invert, bool verbosity, std::function<void(int, int)> callback, int threads, bool normalized)
+{
+    rt::RayTracingScene scene = load_scene(filename, verbosity, threads);
+    im.create(scene.getHeight(), scene.getWidth(), CV_32FC1);
+    scene.getDistances(im.ptr<float>(), im.step1(), callback);
+    if(normalized)
+    {
+        rt::normalize(im.ptr<float>(), im.cols, im.rows, im.step1(), invert);
+    }
 }
\ No newline at end of file
@@ -16,8 +16,18 @@
 
         float *getDistances(const mat4 &camera, std::function<void(int, int)> callback=[](int,int){}) const;
 */
-float *trace_scene_raw(const std::string &filename, bool invert=false, bool verbosity=false, std::function<void(int,int)> callback=[](int,int){});
+// threads overrides the number of threads set in the scene file, unless it is 0.
+// Distances are scaled into [0, 1] by rt::normalize unless normalized is false, in which
+// case they are left as they were traced, with 0 where nothing was hit, and invert is ignored.
+float *trace_scene_raw(const std::string &filename, bool invert=false, bool verbosity=false, std::function<void(int,int)> callback=[](int,int){}, int threads=0, bool normalized=true);
 
-cv::Mat trace_scene(const std::string &filename, bool invert=false, bool verbosity=false, std::function<void(int,int)> callback=[](int,int){});
+cv::Mat trace_scene(const std::string &filename, bool invert=false, bool verbosity=false, std::function<void(int,int)> callback=[](int,int){}, int threads=0, bool normalized=true);
+
+// traces into a buffer owned by the caller, with stride floats from one row to the next.
+// Returns false, without tracing, if the scene is not width x height pixels.
+bool trace_scene_raw(const std::string &filename, float *pix, int width, int height, size_t stride, bool invert=false, bool verbosity=false, std::function<void(int,int)> callback=[](int,int){}, int threads=0, bool normalized=true);
+
+// traces into im, which is reallocated only if it is not already a CV_32FC1 image of the scene's size.
+void trace_scene(const std::string &filename, cv::Mat &im, bool invert=false, bool verbosity=false, std::function<void(int,int)> callback=[](int,int){}, int threads=0, bool normalized=true);
 
 #endif // __RAY_TRACER_HPP__
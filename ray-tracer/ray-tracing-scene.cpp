@@ -1,8 +1,11 @@
 #include "ray-tracing-scene.hpp"
+#include "mapped-file.hpp"
+#include "scene-tokenizer.hpp"
 
-#define TINYOBJLOADER_IMPLEMENTATION
-#include "../include/tiny_obj_loader.h"
-
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
 #include <queue>
 #include <thread>
 
@@ -17,96 +20,280 @@ namespace rt
     constexpr vec3 RayTracingScene::DEFAULT_EYE;
     constexpr vec3 RayTracingScene::DEFAULT_CENTER;
     constexpr vec3 RayTracingScene::DEFAULT_UP;
+    constexpr const char *RayTracingScene::DEFAULT_ACCEL;
+    constexpr int RayTracingScene::PACKET_SIZE;
+    constexpr int RayTracingScene::TILE_SIZE;
+    constexpr const char *RayTracingScene::COMPILED_EXTENSION;
+
+    ShapeContainer *makeContainer(const std::string &name, const float &budget=BVH::DEFAULT_SPLIT_BUDGET)
+    {
+        if(name == "bvh") return new BVHContainer(BVH::SAH);
+        if(name == "lbvh") return new BVHContainer(BVH::MORTON);
+        if(name == "sbvh") return new BVHContainer(BVH::SPATIAL, budget);
+        if(name == "octree") return new OctreeContainer();
+        if(name == "grid") return new GridContainer();
+        if(name == "massbox") return new MassBoxContainer();
+        if(name == "linear") return new LinearContainer();
+        return nullptr;
+    }
 
     RayTracingScene::RayTracingScene():RayTracingScene(DEFAULT_WIDTH, DEFAULT_HEIGHT, DEFAULT_FOV)
     {}
 
-    RayTracingScene::RayTracingScene(const int &width, const int &height, const float &fov):width(width), height(height),w(width), h(height), fov(fov), scale(tanf(fov * M_PI / 180.0f * 0.5f)), aspect(w/h), eye(DEFAULT_EYE), center(DEFAULT_CENTER), up(DEFAULT_UP), verbosity(false)
+    RayTracingScene::RayTracingScene(const int &width, const int &height, const float &fov):width(width), height(height),w(width), h(height), fov(fov), scale(tanf(fov * M_PI / 180.0f * 0.5f)), aspect(w/h), eye(DEFAULT_EYE), center(DEFAULT_CENTER), up(DEFAULT_UP), accel(DEFAULT_ACCEL), splitBudget(BVH::DEFAULT_SPLIT_BUDGET), packets(true), threads(0), verbosity(false)
     {
-        shapes = new MassBoxContainer();
+        shapes.reset(makeContainer(accel));
     }
 
 
-    void getDistSingle(const RayTracingScene * self, float *pix, const int &k, const Ray &ray)
+    void getDistSingle(const RayTracingScene * self, float *pix, const size_t &k, const Ray &ray)
     {
         pix[k] = self->traceDistance(ray);
     }
 
     float *RayTracingScene::getDistances(std::function<void(int, int)> callback) const
+    {
+        float *pix = new float[width * height];
+        getDistances(pix, width, callback);
+        return pix;
+    }
+
+    void RayTracingScene::getDistances(float *pix, const size_t &stride, std::function<void(int, int)> callback) const
     {
         mat4 camera = lookAt(eye, center, up);
-        int total = width * height;
-        float *pix = new float[total];
-        int k = 0;
         vec3 orig = transformPt(camera, {0, 0, 0});
+        auto primary = [&](const int &i, const int &j)
+        {
+            float x = (2.0f * (i + 0.5f) / w - 1.0f) * scale * aspect;
+            float y = (1.0f - 2.0f * (j + 0.5f) / h) * scale;
+            vec3 dir = transformDir(camera, {x, y, 1});
+            return Ray(orig, norm(dir));
+        };
 
-        for(int j = 0;j < height;j++)
+        int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+        int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+        int tiles = tilesX * tilesY;
+        std::mutex progress;
+        int finished = 0;
+        pool->parallelFor(tiles, [&](size_t tile)
         {
-            if(verbosity) std::cout << j << "/" << height << std::endl;
-            for(int i = 0;i < width;i++)
+            int ti0 = tile % tilesX * TILE_SIZE, tj0 = tile / tilesX * TILE_SIZE;
+            int ti1 = std::min(ti0 + TILE_SIZE, width), tj1 = std::min(tj0 + TILE_SIZE, height);
+            if(packets)
             {
-                float x = (2.0f * (i + 0.5f) / w - 1.0f) * scale * aspect;
-                float y = (1.0f - 2.0f * (j + 0.5f) / h) * scale;
-                vec3 dir = transformDir(camera, {x, y, 1});
-                Ray ray(orig, norm(dir));
-                getDistSingle(this, pix, k, ray);
-                k++;
+                // a tile is split by the direction signs of its rays, so the tiles the view axis crosses stay coherent.
+                RayPacket packet[8];
+                float t[8][RayPacket::MAX_SIZE];
+                size_t k[8][RayPacket::MAX_SIZE];
+                for(int j0 = tj0;j0 < tj1;j0 += PACKET_SIZE)
+                {
+                    int j1 = std::min(j0 + PACKET_SIZE, tj1);
+                    for(int i0 = ti0;i0 < ti1;i0 += PACKET_SIZE)
+                    {
+                        int i1 = std::min(i0 + PACKET_SIZE, ti1);
+                        for(RayPacket &p : packet) p.clear();
+                        for(int j = j0;j < j1;j++)
+                        {
+                            for(int i = i0;i < i1;i++)
+                            {
+                                Ray ray = primary(i, j);
+                                int o = ray.sign[0] | ray.sign[1] << 1 | ray.sign[2] << 2;
+                                t[o][packet[o].size] = MAX_FLOAT;
+                                k[o][packet[o].size] = j * stride + i;
+                                packet[o].add(ray);
+                            }
+                        }
+                        for(int o = 0;o < 8;o++)
+                        {
+                            if(packet[o].size == 0) continue;
+                            shapes->intersectPacket(packet[o], t[o]);
+                            for(int n = 0;n < packet[o].size;n++)
+                            {
+                                pix[k[o][n]] = t[o][n] < MAX_FLOAT ? t[o][n] : 0;
+                            }
+                        }
+                    }
+                }
+            }
+            else
+            {
+                for(int j = tj0;j < tj1;j++)
+                {
+                    for(int i = ti0;i < ti1;i++)
+                    {
+                        getDistSingle(this, pix, j * stride + i, primary(i, j));
+                    }
+                }
             }
             if(verbosity)
-                callback(j, height);
-        }
-        return pix;
+            {
+                std::lock_guard<std::mutex> guard(progress);
+                finished++;
+                std::cout << finished << "/" << tiles << std::endl;
+                callback(finished, tiles);
+            }
+        });
     }
 
     void RayTracingScene::addShape(Shape *s)
     {
-        shapes->addShape(new BoundingBox(s));
+        primitives.push_back(s);
     }
 
-    void RayTracingScene::addObj(const std::string &filename, const Transform &t)
+    void RayTracingScene::build()
     {
-        tinyobj::attrib_t attrib;
-        std::vector<tinyobj::shape_t> objshapes;
-        std::vector<tinyobj::material_t> materials;
-        std::string warn, err;
-        bool ret = tinyobj::LoadObj(&attrib, &objshapes, &materials, &warn, &err, filename.c_str());
-        if(!warn.empty())
+        for(auto &mesh : meshes)
         {
-            std::cout << warn << std::endl;
+            if(mesh.second.mesh->isBuilt(buildMode(), splitBudget)) continue;
+            // shared meshes are never rebuilt in place, the instances are moved to a build for the accel instead.
+            std::shared_ptr<const TriangleMesh> built = getMesh(mesh.first, mesh.second.mesh.get());
+            for(auto instance : mesh.second.instances)
+            {
+                instance->setMesh(built.get());
+            }
+            mesh.second.mesh = built;
         }
+        shapes.reset(makeContainer(accel, splitBudget));
+        for(auto s : primitives)
+        {
+            shapes->addShape(s);
+        }
+        shapes->build();
+        threadPool();
+    }
 
-        if(!err.empty())
+    ThreadPool &RayTracingScene::threadPool()
+    {
+        if(!pool)
         {
-            std::cerr << err << std::endl;
+            pool.reset(new ThreadPool(threads));
         }
+        return *pool;
+    }
 
-        if(!ret)
+    bool RayTracingScene::refit()
+    {
+        for(auto s : primitives)
         {
-            return;
+            s->update();
         }
+        return shapes->refit();
+    }
+
+    bool RayTracingScene::setAccel(const std::string &name)
+    {
+        ShapeContainer *container = makeContainer(name);
+        if(container == nullptr)
+        {
+            return false;
+        }
+        delete container;
+        accel = name;
+        return true;
+    }
+
+    // loads an obj file, or a binary mesh file by its extension.
+    static TriangleMesh *loadMesh(const std::string &filename, ThreadPool &pool)
+    {
+        bool binary = std::filesystem::path(filename).extension() == TriangleMesh::BINARY_EXTENSION;
+        return binary ? TriangleMesh::FromBinary(filename) : TriangleMesh::FromObj(filename, pool);
+    }
+
+    BVH::BuildMode RayTracingScene::buildMode() const
+    {
+        return accel == "lbvh" ? BVH::MORTON : accel == "sbvh" ? BVH::SPATIAL : BVH::SAH;
+    }
 
-        mat4 m = t.mat();
-        for(size_t s = 0;s < objshapes.size();s++)
+    std::shared_ptr<const TriangleMesh> RayTracingScene::getMesh(const std::string &filename, const TriangleMesh *source)
+    {
+        BVH::BuildMode mode = buildMode();
+        auto found = embedded.find(filename);
+        if(found != embedded.end())
         {
-            size_t index_offset = 0;
-            for(size_t f = 0;f < objshapes[s].mesh.num_face_vertices.size();f++)
+            // the meshes of a compiled scene are its own, not those of the file they were compiled from.
+            TriangleMesh *mesh = new TriangleMesh(*found->second);
+            mesh->build(mode, splitBudget);
+            return std::shared_ptr<const TriangleMesh>(mesh);
+        }
+        return MeshCache::global().get(filename, mode, splitBudget, [&]() -> TriangleMesh *
+        {
+            MappedFile file;
+            uint64_t key = 0;
+            std::string cacheFile;
+            if(!cacheDir.empty() && file.open(filename))
             {
-                size_t fv = objshapes[s].mesh.num_face_vertices[f];
-                vec3 verts[3];
-                for(size_t v = 0;v < fv;v++)
+                // the build is hashed in too, so every build of a file has its own cache file.
+                uint32_t budgetBits = 0;
+                if(mode == BVH::SPATIAL) memcpy(&budgetBits, &splitBudget, sizeof(budgetBits));
+                key = hashBytes(file.data(), file.size(), static_cast<uint64_t>(mode) << 32 | budgetBits);
+                char name[32];
+                snprintf(name, sizeof(name), "%016llx.rtmesh", static_cast<unsigned long long>(key));
+                cacheFile = cacheDir + "/" + name;
+                TriangleMesh *cached = TriangleMesh::FromCache(cacheFile, key, file.size());
+                if(cached != nullptr && cached->isBuilt(mode, splitBudget))
                 {
-                    tinyobj::index_t idx = objshapes[s].mesh.indices[index_offset + v];
-                    tinyobj::real_t x = attrib.vertices[3 * idx.vertex_index + 0];
-                    tinyobj::real_t y = attrib.vertices[3 * idx.vertex_index + 1];
-                    tinyobj::real_t z = attrib.vertices[3 * idx.vertex_index + 2];
-                    verts[v] = transformPt(m, {x, y, z});
+                    return cached;
                 }
-                addShape(new BoundingBox(new Triangle(verts[0], verts[1], verts[2])));
-                index_offset += fv;
+                delete cached;
+            }
+            TriangleMesh *mesh = source != nullptr ? new TriangleMesh(*source) : loadMesh(filename, threadPool());
+            if(mesh == nullptr)
+            {
+                return nullptr;
+            }
+            mesh->build(mode, splitBudget);
+            if(!cacheFile.empty() && !mesh->save(cacheFile, key, file.size()))
+            {
+                std::cerr << "Error writing mesh cache: " << cacheFile << std::endl;
             }
+            return mesh;
+        });
+    }
+
+    Instance *RayTracingScene::addObj(const std::string &filename, const Transform &t)
+    {
+        SceneMesh &mesh = meshes[filename];
+        if(mesh.mesh == nullptr)
+        {
+            mesh.mesh = getMesh(filename, nullptr);
+            if(mesh.mesh == nullptr)
+            {
+                meshes.erase(filename);
+                return nullptr;
+            }
+        }
+        Instance *instance = new Instance(mesh.mesh.get(), t.mat());
+        mesh.instances.push_back(instance);
+        addShape(instance);
+        return instance;
+    }
+
+    void RayTracingScene::setPackets(const bool &packets)
+    {
+        this->packets = packets;
+    }
+
+    void RayTracingScene::setThreads(const int &threads)
+    {
+        bool changed = std::max(threads, 0) != this->threads;
+        this->threads = std::max(threads, 0);
+        if(changed && pool)
+        {
+            // a running pool is started again with the new count, so a built scene can be traced straight away.
+            pool.reset(new ThreadPool(this->threads));
         }
     }
 
+    void RayTracingScene::setSplitBudget(const float &budget)
+    {
+        splitBudget = budget;
+    }
+
+    void RayTracingScene::setCacheDir(const std::string &dir)
+    {
+        cacheDir = dir;
+    }
+
     void RayTracingScene::setWidth(const int &width)
     {
         this->width = width;
@@ -140,7 +327,7 @@ namespace rt
 
     size_t RayTracingScene::size() const
     {
-        return shapes->size();
+        return primitives.size();
     }
 
     void RayTracingScene::setVerbosity(const bool &v)
@@ -163,93 +350,353 @@ namespace rt
         up = v;
     }
 
-    RayTracingScene RayTracingScene::FromScene(const std::string &filename)
+    /**
+     * SceneRecord:
+     * ------------
+     * one directive of a scene file, in the order it appears.  Names, such as
+     * the path of an obj or the accel, are indices into a table of strings
+     * kept next to the records, so every record has the same size and a
+     * compiled scene stores them as a plain array.
+     */
+    struct SceneRecord
     {
-        RayTracingScene scene;
-        std::ifstream f(filename);
-        if(!f.is_open())
+        enum Kind : uint32_t {WIDTH, HEIGHT, FOV, SPHERE, TRIANGLE, OBJ, ACCEL, PACKETS, THREADS, BUDGET, CACHE, EYE, CENTER, UP, KINDS};
+        uint32_t kind;
+        int32_t number;     // width, height, packets, threads, or the index of a name
+        float value;        // fov, budget or radius
+        vec3 v[3];          // sphere center, triangle corners, obj translation, rotation and scale, or the camera vector
+    };
+
+    /**
+     * parseScene:
+     * -----------
+     * reads the directives of a scene file with a SceneTokenizer.  A malformed
+     * directive ends the file, keeping the directives before it.
+     *
+     * @return false if the file could not be opened.
+     */
+    static bool parseScene(const std::string &filename, std::vector<SceneRecord> &records, std::vector<std::string> &names)
+    {
+        SceneTokenizer f;
+        if(!f.open(filename))
         {
-            std::cerr << "Error reading: " << filename << ".  Using default settings." << std::endl;
-            perror(filename.c_str());
-            return scene;
+            return false;
         }
-        std::string label;
-        while(f >> label)
+        auto name = [&](const std::string &s)
         {
-            std::transform(label.begin(), label.end(), label.begin(), [](unsigned char c){return std::tolower(c);});
+            names.push_back(s);
+            return static_cast<int32_t>(names.size() - 1);
+        };
+        std::string label, word;
+        while(f.label(label))
+        {
+            SceneRecord r = {SceneRecord::KINDS, 0, 0, {}};
             if(label == "width")
             {
-                int width;
-                f >> width;
-                scene.setWidth(width);
+                r.kind = SceneRecord::WIDTH;
+                f >> r.number;
             }
             else if(label == "height")
             {
-                int height;
-                f >> height;
-                scene.setHeight(height);
+                r.kind = SceneRecord::HEIGHT;
+                f >> r.number;
             }
             else if(label == "fov")
             {
-                float fov;
-                f >> fov;
-                scene.setFov(fov);
+                r.kind = SceneRecord::FOV;
+                f >> r.value;
             }
             else if(label == "sphere")
             {
-                vec3 center;
-                float r;
-                f >> center >> r;
-                scene.addShape(new Sphere(center, r));
+                r.kind = SceneRecord::SPHERE;
+                f >> r.v[0] >> r.value;
             }
             else if(label == "triangle")
             {
-                vec3 a,b,c;
-                f >> a >> b >> c;
-                scene.addShape(new Triangle(a, b, c));
+                r.kind = SceneRecord::TRIANGLE;
+                f >> r.v[0] >> r.v[1] >> r.v[2];
             }
             else if(label == "obj")
             {
-                std::string path;
-                vec3 t, r, s;
-                f >> path >> t >> r >> s;
-                scene.addObj(path, Transform(t, r, s));
+                r.kind = SceneRecord::OBJ;
+                f >> word >> r.v[0] >> r.v[1] >> r.v[2];
+                r.number = name(word);
+            }
+            else if(label == "accel")
+            {
+                r.kind = SceneRecord::ACCEL;
+                f.label(word);
+                r.number = name(word);
+            }
+            else if(label == "packets")
+            {
+                r.kind = SceneRecord::PACKETS;
+                f >> r.number;
+            }
+            else if(label == "threads")
+            {
+                r.kind = SceneRecord::THREADS;
+                f >> r.number;
             }
-            else if(label == "eye")
+            else if(label == "budget")
             {
-                vec3 eye;
-                f >> eye;
-                scene.setEye(eye);
+                r.kind = SceneRecord::BUDGET;
+                f >> r.value;
             }
-            else if(label == "center")
+            else if(label == "cache")
             {
-                vec3 center;
-                f >> center;
-                scene.setCenter(center);
+                r.kind = SceneRecord::CACHE;
+                f >> word;
+                r.number = name(word);
             }
-            else if(label == "up")
+            else if(label == "eye" || label == "center" || label == "up")
             {
-                vec3 up;
-                f >> up;
-                scene.setUp(up);
+                r.kind = label == "eye" ? SceneRecord::EYE : label == "center" ? SceneRecord::CENTER : SceneRecord::UP;
+                f >> r.v[0];
             }
             else if(label == "camera")
             {
                 vec3 eye, center, up;
                 f >> eye >> center >> up;
-                scene.setEye(eye);
-                scene.setCenter(center);
-                scene.setUp(up);
+                if(f)
+                {
+                    records.push_back({SceneRecord::EYE, 0, 0, {eye}});
+                    records.push_back({SceneRecord::CENTER, 0, 0, {center}});
+                    records.push_back({SceneRecord::UP, 0, 0, {up}});
+                }
+            }
+            if(f && r.kind != SceneRecord::KINDS)
+            {
+                records.push_back(r);
+            }
+        }
+        if(!f.eof())
+        {
+            std::cerr << "Error parsing: " << filename << ":" << f.line() << ".  Ignoring the rest of the file." << std::endl;
+        }
+        return true;
+    }
+
+    /**
+     * SceneFileHeader:
+     * ----------------
+     * the start of a compiled scene, followed by the names, each ending in a
+     * '\0', the records, and then every mesh as its name's index and size
+     * followed by the mesh in the binary mesh format.
+     */
+    struct SceneFileHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t reserved;
+        uint64_t names;         // bytes of names
+        uint64_t records;
+        uint64_t meshes;
+    };
+
+    struct SceneFileMesh
+    {
+        uint32_t name;
+        uint32_t reserved;
+        uint64_t size;
+    };
+
+    static constexpr char SCENE_FILE_MAGIC[8] = "RTSCENE";
+    static constexpr uint32_t SCENE_FILE_VERSION = 1;
+
+    /**
+     * readCompiled:
+     * -------------
+     * reads the names, records and meshes of a compiled scene.
+     *
+     * @return false if the file could not be read or is damaged.
+     */
+    static bool readCompiled(const std::string &filename, std::vector<SceneRecord> &records, std::vector<std::string> &names, std::vector<std::pair<uint32_t, TriangleMesh *>> &meshes)
+    {
+        MappedFile file;
+        if(!file.open(filename) || file.size() < sizeof(SceneFileHeader))
+        {
+            return false;
+        }
+        SceneFileHeader header;
+        memcpy(&header, file.data(), sizeof(header));
+        const char *p = file.data() + sizeof(header), *end = file.data() + file.size();
+        if(memcmp(header.magic, SCENE_FILE_MAGIC, sizeof(header.magic)) != 0 || header.version != SCENE_FILE_VERSION
+            || header.names > static_cast<size_t>(end - p) || header.records > (end - p - header.names) / sizeof(SceneRecord)
+            || (header.names > 0 && p[header.names - 1] != '\0'))
+        {
+            return false;
+        }
+        for(const char *name = p;name < p + header.names;name += names.back().size() + 1)
+        {
+            names.emplace_back(name);
+        }
+        p += header.names;
+        records.resize(header.records);
+        memcpy(records.data(), p, header.records * sizeof(SceneRecord));
+        p += header.records * sizeof(SceneRecord);
+        bool ok = true;
+        for(const auto &r : records)
+        {
+            bool named = r.kind == SceneRecord::OBJ || r.kind == SceneRecord::ACCEL || r.kind == SceneRecord::CACHE;
+            ok = ok && r.kind < SceneRecord::KINDS && (!named || (r.number >= 0 && static_cast<size_t>(r.number) < names.size()));
+        }
+        // every size is compared with the bytes left, so a damaged one never moves p past the end.
+        for(uint64_t m = 0;ok && m < header.meshes;m++)
+        {
+            SceneFileMesh mesh;
+            if(static_cast<size_t>(end - p) < sizeof(mesh))
+            {
+                ok = false;
+                break;
+            }
+            memcpy(&mesh, p, sizeof(mesh));
+            p += sizeof(mesh);
+            TriangleMesh *loaded = nullptr;
+            if(mesh.name < names.size() && mesh.size <= static_cast<size_t>(end - p))
+            {
+                loaded = TriangleMesh::FromBinary(p, mesh.size);
+                p += mesh.size;
+            }
+            ok = loaded != nullptr;
+            if(ok) meshes.push_back({mesh.name, loaded});
+        }
+        if(!ok || p != end)
+        {
+            for(auto &mesh : meshes) delete mesh.second;
+            meshes.clear();
+            return false;
+        }
+        return true;
+    }
+
+    void RayTracingScene::apply(const SceneRecord &r, const std::vector<std::string> &names)
+    {
+        switch(r.kind)
+        {
+        case SceneRecord::WIDTH: setWidth(r.number); break;
+        case SceneRecord::HEIGHT: setHeight(r.number); break;
+        case SceneRecord::FOV: setFov(r.value); break;
+        case SceneRecord::SPHERE: addShape(new Sphere(r.v[0], r.value)); break;
+        case SceneRecord::TRIANGLE: addShape(new Triangle(r.v[0], r.v[1], r.v[2])); break;
+        case SceneRecord::OBJ: addObj(names[r.number], Transform(r.v[0], r.v[1], r.v[2])); break;
+        case SceneRecord::ACCEL:
+            if(!setAccel(names[r.number]))
+            {
+                std::cerr << "Unknown accel: " << names[r.number] << ".  Using " << accel << "." << std::endl;
             }
+            break;
+        case SceneRecord::PACKETS: setPackets(r.number != 0); break;
+        case SceneRecord::THREADS: setThreads(r.number); break;
+        case SceneRecord::BUDGET: setSplitBudget(r.value); break;
+        case SceneRecord::CACHE: setCacheDir(names[r.number]); break;
+        case SceneRecord::EYE: setEye(r.v[0]); break;
+        case SceneRecord::CENTER: setCenter(r.v[0]); break;
+        case SceneRecord::UP: setUp(r.v[0]); break;
         }
+    }
+
+    RayTracingScene RayTracingScene::FromScene(const std::string &filename)
+    {
+        RayTracingScene scene;
+        std::vector<SceneRecord> records;
+        std::vector<std::string> names;
+        std::vector<std::pair<uint32_t, TriangleMesh *>> meshes;
+        bool compiled = std::filesystem::path(filename).extension() == COMPILED_EXTENSION;
+        errno = 0;
+        if(compiled ? !readCompiled(filename, records, names, meshes) : !parseScene(filename, records, names))
+        {
+            std::cerr << "Error reading: " << filename << ".  Using default settings." << std::endl;
+            if(errno != 0)
+            {
+                perror(filename.c_str());
+            }
+            scene.build();
+            return scene;
+        }
+        // the meshes of a compiled scene are in place before its obj directives look for them.
+        for(const auto &mesh : meshes)
+        {
+            scene.embedded[names[mesh.first]] = std::shared_ptr<const TriangleMesh>(mesh.second);
+        }
+        for(const auto &record : records)
+        {
+            scene.apply(record, names);
+        }
+        scene.build();
 
         std::cout << filename << std::endl;
         std::cout << "[w x h]: " << "[" << scene.width << " x " << scene.height << "]" << std::endl;
         std::cout << "fov: " << scene.fov << std::endl;
         std::cout << "Number of shapes: " << scene.size() << std::endl;
+        size_t triangles = 0;
+        for(const auto &mesh : scene.meshes)
+        {
+            triangles += mesh.second.mesh->size();
+        }
+        std::cout << "Number of meshes: " << scene.meshes.size() << " (" << triangles << " triangles)" << std::endl;
+        std::cout << "accel: " << scene.accel << std::endl;
         return scene;
     }
 
+    bool RayTracingScene::Compile(const std::string &filename, const std::string &outfile)
+    {
+        std::vector<SceneRecord> records;
+        std::vector<std::string> names;
+        if(!parseScene(filename, records, names))
+        {
+            std::cerr << "Error reading: " << filename << std::endl;
+            return false;
+        }
+
+        // every obj file is loaded once, however many times it is placed.
+        std::map<std::string, std::pair<uint32_t, TriangleMesh *>> meshes;
+        ThreadPool pool;
+        bool ok = true;
+        for(const auto &r : records)
+        {
+            if(r.kind != SceneRecord::OBJ || meshes.count(names[r.number])) continue;
+            TriangleMesh *mesh = loadMesh(names[r.number], pool);
+            if(mesh == nullptr)
+            {
+                ok = false;
+                break;
+            }
+            meshes[names[r.number]] = {static_cast<uint32_t>(r.number), mesh};
+        }
+
+        std::string block;
+        for(const auto &name : names)
+        {
+            block.append(name.c_str(), name.size() + 1);
+        }
+        SceneFileHeader header;
+        memcpy(header.magic, SCENE_FILE_MAGIC, sizeof(header.magic));
+        header.version = SCENE_FILE_VERSION;
+        header.reserved = 0;
+        header.names = block.size();
+        header.records = records.size();
+        header.meshes = meshes.size();
+
+        ok = ok && writeFile(outfile, [&](std::ofstream &f)
+        {
+            f.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            f.write(block.data(), block.size());
+            f.write(reinterpret_cast<const char *>(records.data()), records.size() * sizeof(SceneRecord));
+            for(const auto &mesh : meshes)
+            {
+                SceneFileMesh entry = {mesh.second.first, 0, mesh.second.second->binarySize()};
+                f.write(reinterpret_cast<const char *>(&entry), sizeof(entry));
+                mesh.second.second->writeBinary(f);
+            }
+        });
+        for(auto &mesh : meshes)
+        {
+            delete mesh.second.second;
+        }
+        return ok;
+    }
+
     float RayTracingScene::traceDistance(const Ray &ray) const
     {
         float t = std::numeric_limits<float>::max();
@@ -3,18 +3,28 @@
 
 #include "vec3.hpp"
 #include "shape.hpp"
+#include "bvh.hpp"
+#include "octree.hpp"
+#include "grid.hpp"
+#include "mesh.hpp"
+#include "mesh-cache.hpp"
 #include "mat4.hpp"
 #include "utils.hpp"
 #include "transform.hpp"
+#include "thread-pool.hpp"
 
 #include <vector>
 #include <fstream>
 #include <algorithm>
 #include <functional>
+#include <map>
+#include <memory>
 
 
 namespace rt
 {
+    struct SceneRecord;
+
     /**
      * RayTracingScene:
      * ----------------
@@ -30,6 +40,11 @@ namespace rt
         static constexpr vec3 DEFAULT_EYE = {0, 0, -1};
         static constexpr vec3 DEFAULT_CENTER = {0, 0, 0};
         static constexpr vec3 DEFAULT_UP = {0, 1, 0};
+        static constexpr const char *DEFAULT_ACCEL = "bvh";
+        // the side of the square image tiles traced together as one ray packet.
+        static constexpr int PACKET_SIZE = 8;
+        // the side of the square image tiles handed to the threads, a multiple of PACKET_SIZE.
+        static constexpr int TILE_SIZE = 32;
         /**
          * RayTracingScene:
          * ----------------
@@ -51,31 +66,136 @@ namespace rt
         /**
          * getDistances:
          * -------------
-         * retrieve the distances from a camera to the scene geometry.
+         * retrieve the distances from a camera to the scene geometry.  The image
+         * is traced in TILE_SIZE x TILE_SIZE tiles spread over the scene's threads.
          *
-         * @param camera: mat4 the camera matrix
+         * @param callback: function called with the number of finished tiles and
+         *                  the total number of tiles each time a tile is done, when
+         *                  the scene is verbose.  The calls never overlap, but may
+         *                  come from any thread.
          * @return the distances from camera to scene geometry.
+         * NOTE: the scene needs to have been built.
          * NOTE: the values from this function are dynamically allocated and need to be cleaned up by the caller.
          */
         float *getDistances(std::function<void(int, int)> callback=[](int,int){}) const;
 
+        /**
+         * getDistances:
+         * -------------
+         * retrieve the distances from a camera to the scene geometry into a
+         * buffer owned by the caller, such as the data of a cv::Mat or of a
+         * numpy array, which saves allocating and copying a frame per render.
+         *
+         * @param pix: float* the first pixel of the image, which has to hold height rows of width floats.
+         * @param stride: size_t the number of floats from the start of one row to the next, at least width.
+         * @param callback: function called as each tile is done, as for the other overload.
+         */
+        void getDistances(float *pix, const size_t &stride, std::function<void(int, int)> callback=[](int,int){}) const;
+
         /**
          * addShape:
          * ---------
          * adds a shape to the scene.
          *
          * @param s: Shape* the shape to add
+         * NOTE: build needs to be called once all the shapes have been added.
          */
         void addShape(Shape *s);
 
         /**
          * addObj:
          * -------
-         * add triangles from an obj file.
+         * adds an instance of the mesh in an obj file, or in a binary mesh file
+         * if the name ends in TriangleMesh::BINARY_EXTENSION.  Meshes come from
+         * MeshCache::global, built for the scene's accel, so each file is only
+         * loaded and built once for each accel, however many scenes of the
+         * process place it, and every further call just places another
+         * instance of it.
+         *
+         * @param filename: string the name of the obj or binary mesh file.
+         * @param t: Transform the placement of this instance.
+         * @return the instance, which can be moved with setTransform, or nullptr if the file could not be loaded.
+         */
+        Instance *addObj(const std::string &filename, const Transform &t=Transform());
+
+        /**
+         * build:
+         * ------
+         * builds the acceleration structure over every shape added so far.
+         * Meshes added before the accel or split budget changed are swapped for
+         * builds matching them, the shared meshes themselves are left as they are.
+         */
+        void build();
+
+        /**
+         * refit:
+         * ------
+         * updates the acceleration structure after shapes were moved in place,
+         * e.g. with Sphere::setCenter or Instance::setTransform, so the next
+         * frame of an animation can be traced without a full build.  The
+         * structure is only rebuilt once refitting has worn it out.
+         *
+         * @return true if the acceleration structure was rebuilt, false if it was refit.
+         */
+        bool refit();
+
+        /**
+         * setAccel:
+         * ---------
+         * selects the acceleration structure used to hold the shapes.
+         *
+         * @param name: string one of "bvh", "lbvh", "sbvh", "octree", "grid", "massbox" or "linear".
+         * @return false if the name is unknown, in which case the selection is unchanged.
+         */
+        bool setAccel(const std::string &name);
+
+        /**
+         * setPackets:
+         * -----------
+         * selects whether getDistances traces PACKET_SIZE x PACKET_SIZE tiles
+         * of primary rays as packets, or every ray on its own.  A tile is split
+         * into one packet per direction sign octant; rays with a zero direction
+         * component leave their packet incoherent, and it is then traced ray
+         * by ray.
+         * NOTE: the two visit BVH nodes in a different order, so a ray through
+         * overlapping coplanar shapes may hit a different one of them, at a
+         * depth differing in the last bits.
          *
-         * @param filename: string the name of the obj file.
+         * @param packets: bool true to trace packets.
          */
-        void addObj(const std::string &filename, const Transform &t=Transform());
+        void setPackets(const bool &packets);
+
+        /**
+         * setThreads:
+         * -----------
+         * sets how many threads getDistances traces with, restarting the
+         * scene's pool if it is already running.
+         *
+         * @param threads: int the number of threads, 0 uses one per hardware thread.
+         */
+        void setThreads(const int &threads);
+
+        /**
+         * setSplitBudget:
+         * ---------------
+         * sets how many extra primitive references the "sbvh" builder may add
+         * by splitting primitives, as a fraction of the primitive count.
+         *
+         * @param budget: float the fraction, 0 disables spatial splits.
+         */
+        void setSplitBudget(const float &budget);
+
+        /**
+         * setCacheDir:
+         * ------------
+         * sets a directory where built meshes are saved, keyed by the contents of
+         * their obj file.  Later loads of the same file read the mesh and its BVH
+         * from there instead of parsing and building it again.
+         *
+         * @param dir: string the cache directory, or empty to disable caching.
+         * NOTE: only affects obj files added after this call.
+         */
+        void setCacheDir(const std::string &dir);
 
         void setWidth(const int &width);
         void setHeight(const int &height);
@@ -90,8 +210,34 @@ namespace rt
 
         void setVerbosity(const bool &v);
 
+        /**
+         * FromScene:
+         * ----------
+         * loads a scene file, or a compiled scene if the name ends in
+         * COMPILED_EXTENSION, and builds it.
+         *
+         * @param filename: string the name of the scene file.
+         * @return the scene, with default settings if the file could not be read.
+         */
         static RayTracingScene FromScene(const std::string &filename);
 
+        /**
+         * Compile:
+         * --------
+         * turns a scene file into a compiled scene: its directives as fixed size
+         * binary records, followed by every mesh it places in the binary mesh
+         * format.  The compiled scene needs none of the files it was made from,
+         * and FromScene loads it with no parsing at all.
+         *
+         * @param filename: string the name of the scene file.
+         * @param outfile: string the name of the compiled scene, conventionally ending in COMPILED_EXTENSION.
+         * @return true if the compiled scene was written, false otherwise.
+         */
+        static bool Compile(const std::string &filename, const std::string &outfile);
+
+        // the extension of compiled scenes, which FromScene loads without parsing.
+        static constexpr const char *COMPILED_EXTENSION = ".rtscene";
+
         /**
          * traceDistance:
          * --------------
@@ -102,14 +248,36 @@ namespace rt
          */
         float traceDistance(const Ray &ray) const;
     private:
+        // the pool getDistances and obj loads run on, started on first use.
+        ThreadPool &threadPool();
+
+        // the mesh of a file built for the accel and split budget, from source when given rather than loaded.
+        std::shared_ptr<const TriangleMesh> getMesh(const std::string &filename, const TriangleMesh *source);
+        BVH::BuildMode buildMode() const;
+
         int width, height;
         float w, h, fov, scale, aspect;
         vec3 eye, center, up;
-        ShapeContainer *shapes;
-        // std::vector<Shape *> shapes;
-        // OctreeNode octree;
+        std::string accel;
+        float splitBudget;
+        bool packets;
+        int threads;
+        std::unique_ptr<ThreadPool> pool;   // started by threadPool, at the latest by build
+        std::vector<Shape *> primitives;
+        struct SceneMesh
+        {
+            std::shared_ptr<const TriangleMesh> mesh;   // shared with MeshCache::global and other scenes
+            std::vector<Instance *> instances;
+        };
+        std::map<std::string, SceneMesh> meshes;
+        std::map<std::string, std::shared_ptr<const TriangleMesh>> embedded;   // the unbuilt meshes of a compiled scene
+        std::string cacheDir;
+        std::unique_ptr<ShapeContainer> shapes;
         bool verbosity;
 
+        // carries out one directive of a scene file, whose names are indices into names.
+        void apply(const SceneRecord &record, const std::vector<std::string> &names);
+
         
     };
 
@@ -1,11 +1,67 @@
 #include "ray.hpp"
 
+#include <algorithm>
+
 namespace rt
 {
-    Ray::Ray(const vec3 &o, const vec3 &d):orig(o),dir(d),invdir(1/d)
+    /**
+     * reciprocal:
+     * -----------
+     * 1 / f, clamped to +-MAX_INVDIR.  An axis parallel direction would
+     * otherwise give an infinity, and the slab tests a NaN.
+     */
+    static float reciprocal(const float &f)
+    {
+        return std::min(std::max(1 / f, -Ray::MAX_INVDIR), Ray::MAX_INVDIR);
+    }
+
+    Ray::Ray(const vec3 &o, const vec3 &d):orig(o),dir(d)
+    {
+        invdir = {reciprocal(d.x), reciprocal(d.y), reciprocal(d.z)};
+        oinvdir = {o.x * invdir.x, o.y * invdir.y, o.z * invdir.z};
+        // taken from invdir so that a -0 component picks the same planes as its reciprocal.
+        sign[0] = invdir.x < 0;
+        sign[1] = invdir.y < 0;
+        sign[2] = invdir.z < 0;
+    }
+
+    constexpr float Ray::MAX_INVDIR;
+
+    Ray::Ray()
+    {}
+
+    constexpr int RayPacket::MAX_SIZE;
+
+    RayPacket::RayPacket():size(0), coherent(true)
+    {}
+
+    void RayPacket::add(const Ray &ray)
+    {
+        if(size == 0)
+        {
+            invmin = invmax = ray.invdir;
+        }
+        else
+        {
+            const Ray &first = rays[0];
+            if(ray.orig.x != first.orig.x || ray.orig.y != first.orig.y || ray.orig.z != first.orig.z ||
+               ray.sign[0] != first.sign[0] || ray.sign[1] != first.sign[1] || ray.sign[2] != first.sign[2])
+            {
+                coherent = false;
+            }
+            invmin = {std::min(invmin.x, ray.invdir.x), std::min(invmin.y, ray.invdir.y), std::min(invmin.z, ray.invdir.z)};
+            invmax = {std::max(invmax.x, ray.invdir.x), std::max(invmax.y, ray.invdir.y), std::max(invmax.z, ray.invdir.z)};
+        }
+        if(ray.dir.x == 0 || ray.dir.y == 0 || ray.dir.z == 0)
+        {
+            coherent = false;
+        }
+        rays[size++] = ray;
+    }
+
+    void RayPacket::clear()
     {
-        sign[0] = d.x < 0;
-        sign[1] = d.y < 0;
-        sign[2] = d.z < 0;
+        size = 0;
+        coherent = true;
     }
 };
\ No newline at end of file
@@ -23,10 +23,52 @@ namespace rt
          */
         Ray(const vec3 &o, const vec3 &d);
 
+        /**
+         * Ray:
+         * ----
+         * constructs an uninitialized ray, to be assigned later.
+         */
+        Ray();
+
+        // past this a direction component counts as zero, which keeps invdir and oinvdir finite.
+        static constexpr float MAX_INVDIR = 1e30f;
+
         vec3 orig, dir, invdir;
+        vec3 oinvdir;   // orig * invdir, so the distance to a plane along an axis is a single fma
         int sign[3];
     };
 
+    /**
+     * RayPacket:
+     * ----------
+     * a group of rays traced together, such as the primary rays of an image
+     * tile.  While every ray shares its origin and direction signs, and no
+     * direction component is zero, the packet is coherent: a box can then be
+     * tested against all of its rays at once, with interval arithmetic over
+     * the range of their reciprocal directions.
+     */
+    class RayPacket
+    {
+    public:
+        static constexpr int MAX_SIZE = 64;
+
+        RayPacket();
+
+        /**
+         * add:
+         * ----
+         * adds a ray to the packet, updating its direction bounds.
+         * NOTE: at most MAX_SIZE rays fit in a packet.
+         */
+        void add(const Ray &ray);
+        void clear();
+
+        Ray rays[MAX_SIZE];
+        int size;
+        bool coherent;
+        vec3 invmin, invmax;    // the range of the reciprocal directions of the rays
+    };
+
 }; // namespace
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,131 @@
+#include "scene-tokenizer.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <limits>
+
+namespace rt
+{
+    static bool isSpace(const char &c)
+    {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+    }
+
+    SceneTokenizer::SceneTokenizer():p(nullptr), end(nullptr), ok(false)
+    {}
+
+    bool SceneTokenizer::open(const std::string &filename)
+    {
+        ok = file.open(filename);
+        p = file.data();
+        end = p + file.size();
+        return ok;
+    }
+
+    bool SceneTokenizer::word(const char *&begin, const char *&last)
+    {
+        if(!ok) return false;
+        while(p < end && isSpace(*p)) p++;
+        begin = p;
+        while(p < end && !isSpace(*p)) p++;
+        last = p;
+        ok = begin != last;
+        return ok;
+    }
+
+    bool SceneTokenizer::label(std::string &word)
+    {
+        const char *begin, *last;
+        if(!this->word(begin, last)) return false;
+        word.resize(last - begin);
+        std::transform(begin, last, word.begin(), [](unsigned char c){return std::tolower(c);});
+        return true;
+    }
+
+    SceneTokenizer &SceneTokenizer::operator>>(std::string &word)
+    {
+        const char *begin, *last;
+        if(this->word(begin, last))
+        {
+            word.assign(begin, last);
+        }
+        return *this;
+    }
+
+    SceneTokenizer &SceneTokenizer::operator>>(int &i)
+    {
+        long long value;
+        if(number(value))
+        {
+            ok = value >= std::numeric_limits<int>::min() && value <= std::numeric_limits<int>::max();
+            i = value;
+        }
+        return *this;
+    }
+
+    SceneTokenizer &SceneTokenizer::operator>>(size_t &i)
+    {
+        long long value;
+        if(number(value))
+        {
+            ok = value >= 0;
+            i = value;
+        }
+        return *this;
+    }
+
+    SceneTokenizer &SceneTokenizer::operator>>(float &f)
+    {
+        number(f);
+        return *this;
+    }
+
+    bool SceneTokenizer::expect(const char &c)
+    {
+        if(!ok) return false;
+        const char *found = static_cast<const char *>(memchr(p, c, end - p));
+        ok = found != nullptr;
+        p = ok ? found + 1 : end;
+        return ok;
+    }
+
+    bool SceneTokenizer::number(float &f)
+    {
+        if(!ok) return false;
+        while(p < end && isSpace(*p)) p++;
+        // from_chars takes no leading plus.
+        if(p < end && *p == '+') p++;
+        auto result = std::from_chars(p, end, f);
+        ok = result.ec == std::errc();
+        p = result.ptr;
+        return ok;
+    }
+
+    bool SceneTokenizer::number(long long &i)
+    {
+        if(!ok) return false;
+        while(p < end && isSpace(*p)) p++;
+        if(p < end && *p == '+') p++;
+        auto result = std::from_chars(p, end, i);
+        ok = result.ec == std::errc();
+        p = result.ptr;
+        return ok;
+    }
+
+    SceneTokenizer::operator bool() const
+    {
+        return ok;
+    }
+
+    bool SceneTokenizer::eof() const
+    {
+        return std::all_of(p, end, isSpace);
+    }
+
+    size_t SceneTokenizer::line() const
+    {
+        return p == nullptr ? 0 : std::count(file.data(), p, '\n') + 1;
+    }
+};
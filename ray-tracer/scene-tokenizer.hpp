@@ -0,0 +1,84 @@
+#ifndef __SCENE_TOKENIZER_HPP__
+#define __SCENE_TOKENIZER_HPP__
+
+#include "mapped-file.hpp"
+
+#include <cstddef>
+#include <string>
+
+namespace rt
+{
+    /**
+     * SceneTokenizer:
+     * ---------------
+     * reads the tokens of a scene file in one pass over a memory mapping of
+     * it, in place of an ifstream.  Tokens are read with >> as from a stream:
+     * words are separated by whitespace, numbers are parsed with from_chars,
+     * and vectors are written "(x, y, z)".  Like a stream, the tokenizer
+     * converts to false once a read has failed, and every later read fails.
+     */
+    class SceneTokenizer
+    {
+    public:
+        SceneTokenizer();
+
+        /**
+         * open:
+         * -----
+         * maps a scene file and starts reading from its first token.
+         *
+         * @param filename: string the name of the scene file.
+         * @return true if the file was opened, false otherwise.
+         */
+        bool open(const std::string &filename);
+
+        /**
+         * label:
+         * ------
+         * reads the next word in lower case, for comparing directive names.
+         *
+         * @param word: string set to the lower case word.
+         * @return false at the end of the file or after a failed read.
+         */
+        bool label(std::string &word);
+
+        SceneTokenizer &operator>>(std::string &word);
+        SceneTokenizer &operator>>(int &i);
+        SceneTokenizer &operator>>(size_t &i);
+        SceneTokenizer &operator>>(float &f);
+
+        /**
+         * operator>>:
+         * -----------
+         * reads a vector written "(x, y, z)" into any type with x, y and z members.
+         */
+        template<typename V>
+        SceneTokenizer &operator>>(V &v)
+        {
+            if(expect('(') && number(v.x) && expect(',') && number(v.y) && expect(',') && number(v.z))
+            {
+                expect(')');
+            }
+            return *this;
+        }
+
+        explicit operator bool() const;
+
+        // true once only whitespace is left, to tell the end of the file from a failed read.
+        bool eof() const;
+
+        // the line the tokenizer stopped at, counting from 1, for error messages.
+        size_t line() const;
+    private:
+        bool word(const char *&begin, const char *&end);
+        bool expect(const char &c);
+        bool number(float &f);
+        bool number(long long &i);
+
+        MappedFile file;
+        const char *p, *end;
+        bool ok;
+    };
+};
+
+#endif // __SCENE_TOKENIZER_HPP__
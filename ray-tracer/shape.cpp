@@ -1,11 +1,19 @@
 #include "shape.hpp"
 
+#include <algorithm>
+#include <limits>
+
 namespace rt
 {
     Triangle::Triangle(const vec3 &a, const vec3 &b, const vec3 &c):a(a),b(b),c(c)
     {}
 
     bool Triangle::intersect(const Ray &ray, float &t) const
+    {
+        return raytriangle(ray, a, b, c, t);
+    }
+
+    bool raytriangle(const Ray &ray, const vec3 &a, const vec3 &b, const vec3 &c, float &t)
     {
         vec3 ab = b - a;
         vec3 ac = c - a;
@@ -20,12 +28,15 @@ namespace rt
         float v = dot(ray.dir, qvec) * idet;
         if(v < 0 || u + v > 1) return false;
         float t0 = dot(ac, qvec) * idet;
-        if(t0 > t) return false;
+        if(t0 < 0 || t0 > t) return false; // the triangle is behind us or another shape is infront of it.
         t = t0;
         return true;
     }
 
-
+    vec3 Triangle::vertex(const int &i) const
+    {
+        return i == 0 ? a : i == 1 ? b : c;
+    }
 
     void Triangle::extents(vec3 &emin, vec3 &emax) const
     {
@@ -48,6 +59,11 @@ namespace rt
     {}
 
     bool Sphere::intersect(const Ray &ray, float &t) const 
+    {
+        return raysphere(ray, center, radius2, t);
+    }
+
+    bool raysphere(const Ray &ray, const vec3 &center, const float &radius2, float &t)
     {
         vec3 L = center - ray.orig;
         float tca = dot(L, ray.dir);
@@ -71,6 +87,21 @@ namespace rt
     }
 
 
+    void Sphere::setCenter(const vec3 &c)
+    {
+        center = c;
+    }
+
+    vec3 Sphere::getCenter() const
+    {
+        return center;
+    }
+
+    float Sphere::getRadius() const
+    {
+        return radius;
+    }
+
     BoundingBox::BoundingBox(Shape *s):shape(s)
     {
         shape->extents(bounds[0], bounds[1]);
@@ -88,61 +119,24 @@ namespace rt
         emin = bounds[0];
         emax = bounds[1];
     }
-
-
-
-    bool raybox(const Ray &ray, const vec3 bounds[2], float &t)
+    const Shape *BoundingBox::getShape() const
     {
-        float tmin, tmax, tymin, tymax, tzmin, tzmax;
-        tmin = (bounds[ray.sign[0]].x - ray.orig.x) * ray.invdir.x;
-        tmax = (bounds[1 - ray.sign[0]].x - ray.orig.x) * ray.invdir.x;
-        tymin = (bounds[ray.sign[1]].y - ray.orig.y) * ray.invdir.y;
-        tymax = (bounds[1 - ray.sign[1]].y - ray.orig.y) * ray.invdir.y;
-
-        if((tmin > tymax) || tymin > tmax)
-        {
-            return false;
-        }
-        if(tymin > tmin)
-        {
-            tmin = tymin;
-        }
-        if(tymax < tmax)
-        {
-            tmax = tymax;
-        }
+        return shape;
+    }
+    void BoundingBox::update()
+    {
+        shape->update();
+        shape->extents(bounds[0], bounds[1]);
+    }
 
-        tzmin = (bounds[ray.sign[2]].z - ray.orig.z) * ray.invdir.z;
-        tzmax = (bounds[1 - ray.sign[2]].z - ray.orig.z) * ray.invdir.z;
 
-        if((tmin > tzmax) || (tzmin > tmax))
-        {
-            return false;
-        }
 
-        if(tzmin > tmin)
-        {
-            tmin = tzmin;
-        }
-        if(tzmax < tmax)
-        {
-            tmax = tzmax;
-        }
-        float t0 = tmin;
-        if(t0 < 0)
+    void ShapeContainer::intersectPacket(const RayPacket &packet, float *t) const
+    {
+        for(int i = 0;i < packet.size;i++)
         {
-            t0 = tmax;
-            if(t0 < 0) return false;
+            intersect(packet.rays[i], t[i]);
         }
-        if(t0 > t) return false;
-        t = t0;
-        return true; 
-    }
-
-    bool raybox(const Ray &ray, const vec3 bounds[2])
-    {
-        float t = std::numeric_limits<float>::max();
-        return raybox(ray, bounds, t);   
     }
 
     bool LinearContainer::intersect(const Ray &ray, float &t) const
@@ -196,15 +190,23 @@ namespace rt
     {
         return shapes.size();
     }
-
-    constexpr size_t OctreeNode::MAX_SIZE;
-    constexpr size_t OctreeNode::MAX_DEPTH;
-
-    OctreeNode::OctreeNode(const vec3 &emin, const vec3 &emax, size_t depth):depth(depth)
+    bool MassBoxContainer::refit()
     {
-        center = (emin + emax) / 2;
-        bounds[0] = emin;
-        bounds[1] = emax;
+        const std::vector<Shape*> &all = shapes.getShapes();
+        for(size_t i = 0;i < all.size();i++)
+        {
+            vec3 emin, emax;
+            all[i]->extents(emin, emax);
+            if(i == 0)
+            {
+                bounds[0] = emin;
+                bounds[1] = emax;
+                continue;
+            }
+            bounds[0] = {std::min(emin.x, bounds[0].x), std::min(emin.y, bounds[0].y), std::min(emin.z, bounds[0].z)};
+            bounds[1] = {std::max(emax.x, bounds[1].x), std::max(emax.y, bounds[1].y), std::max(emax.z, bounds[1].z)};
+        }
+        return false;
     }
 
     bool boxbox(const vec3 bounds1[2], const vec3 bounds2[2])
@@ -214,103 +216,4 @@ namespace rt
             bounds1[0].y <= bounds2[1].y && bounds1[1].y >= bounds2[0].y &&
             bounds1[0].z <= bounds2[1].z && bounds1[1].z >= bounds2[0].z;
     }
-
-    bool OctreeNode::intersect(const Ray &ray, float &t) const
-    {
-        bool hit = false;
-        if(children.size() == 0)
-        {
-            for(size_t i = 0;i < content.size();i++)
-            {
-                if(content[i]->intersect(ray, t))
-                {
-                    hit = true;
-                }
-            }
-        }
-
-        for(size_t i = 0;i < children.size();i++)
-        {
-            if(children[i].intersect(ray, t))
-            {
-                hit = true;
-            }
-        }
-        return hit;
-    }
-    bool OctreeNode::intersect(Shape *shape) const
-    {
-        vec3 emin, emax;
-        shape->extents(emin, emax);
-        vec3 bounds2[2] = {emin, emax};
-        return boxbox(bounds, bounds2);
-    }
-
-    void OctreeNode::addShape(Shape *shape)
-    {
-        if(children.size() == 0)
-        {
-            content.push_back(shape);
-            if(content.size() >= MAX_SIZE && depth < MAX_DEPTH)
-            {
-                split();
-            }
-        }
-        else 
-        {
-            for(auto &child : children)
-            {
-                if(child.intersect(shape))
-                {
-                    child.addShape(shape);
-                }
-            }
-        }
-    }
-
-    void OctreeNode::split()
-    {
-        vec3 qpppnear, qnppnear, qpnpnear, qppnnear, qnnpnear, qnpnnear, qpnnnear, qnnnnear;
-        vec3 qpppfar, qnppfar, qpnpfar, qppnfar, qnnpfar, qnpnfar, qpnnfar, qnnnfar;
-  
-        qpppnear = center;
-        qnppnear = {bounds[0].x, center.y, center.z};
-        qpnpnear = {center.x, bounds[0].y, center.z};
-        qppnnear = {center.x, center.y, bounds[0].z};
-        qnnpnear = {bounds[0].x, bounds[0].y, center.z};
-        qnpnnear = {bounds[0].x, center.y, bounds[0].z};
-        qpnnnear = {center.x, bounds[0].y, bounds[0].z};
-        qnnnnear = {bounds[0].x, bounds[0].y, bounds[0].z};
-
-        qpppfar = bounds[1];
-        qnnnfar = center;
-        qnppfar = {center.x, bounds[1].y, bounds[1].z};
-        qpnpfar = {bounds[1].x, center.y, bounds[1].z};
-        qppnfar = {bounds[1].x, bounds[1].y, center.z};
-        qnnpfar = {center.x, center.y, bounds[1].z};
-        qnpnfar = {center.x, bounds[1].y, center.z};
-        qpnnfar = {bounds[1].x, center.y, center.z};
-
-        children.push_back(OctreeNode(qpppnear, qpppfar, depth+1));
-        children.push_back(OctreeNode(qnppnear, qnppfar, depth+1));
-        children.push_back(OctreeNode(qpnpnear, qpnpfar, depth+1));
-        children.push_back(OctreeNode(qppnnear, qppnfar, depth+1));
-        children.push_back(OctreeNode(qnnpnear, qnnpfar, depth+1));
-        children.push_back(OctreeNode(qnpnnear, qnpnfar, depth+1));
-        children.push_back(OctreeNode(qpnnnear, qpnnfar, depth+1));
-        children.push_back(OctreeNode(qnnnnear, qnnnfar, depth+1));
-        for(auto shape : content)
-        {
-            vec3 emin, emax;
-            shape->extents(emin, emax);
-            vec3 ebounds[2] = {emin, emax};
-            for(auto &child : children)
-            {
-                if(boxbox(child.bounds, ebounds))
-                {
-                    child.addShape(shape);
-                }
-            }
-        }
-    }
 };
\ No newline at end of file
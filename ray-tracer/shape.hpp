@@ -4,6 +4,7 @@
 #include "vec3.hpp"
 #include "ray.hpp"
 
+#include <algorithm>
 #include <cmath>
 #include <vector>
 
@@ -28,6 +29,13 @@ namespace rt
          */
         virtual bool intersect(const Ray &ray, float &t) const = 0;
         virtual void extents(vec3 &emin, vec3 &emax) const = 0;
+
+        /**
+         * update:
+         * -------
+         * refreshes anything cached from the shapes this one wraps, after they moved.
+         */
+        virtual void update() {}
     };
 
     /**
@@ -60,6 +68,7 @@ namespace rt
          */
         virtual bool intersect(const Ray &ray, float &t) const;
         virtual void extents(vec3 &emin, vec3 &emax) const;
+        vec3 vertex(const int &i) const;
     private:
         vec3 a, b, c;
     };
@@ -93,12 +102,116 @@ namespace rt
          */
         virtual bool intersect(const Ray &ray, float &t) const;
         virtual void extents(vec3 &emin, vec3 &emax) const;
+
+        /**
+         * setCenter:
+         * ----------
+         * moves the sphere.
+         * NOTE: the scene needs to be refit before it is traced again.
+         */
+        void setCenter(const vec3 &c);
+        vec3 getCenter() const;
+        float getRadius() const;
     private:
         vec3 center;
         float radius, radius2;
     };
 
-    bool raybox(const Ray &ray, const vec3 bounds[2]);
+    /**
+     * raytriangle:
+     * ------------
+     * performs a Moller-Trumbore intersection test between a ray and a triangle.
+     *
+     * @param ray: Ray the incoming ray.
+     * @param a: vec3 the first vertex.
+     * @param b: vec3 the second vertex.
+     * @param c: vec3 the third vertex.
+     * @param t: float the distance to the closest intersection so far, updated on a closer hit.
+     * @return true if the triangle is hit in front of the ray and closer than t, false otherwise.
+     */
+    bool raytriangle(const Ray &ray, const vec3 &a, const vec3 &b, const vec3 &c, float &t);
+
+    /**
+     * raysphere:
+     * ----------
+     * performs a geometric intersection test between a ray and a sphere.
+     *
+     * @param ray: Ray the incoming ray.
+     * @param center: vec3 the center of the sphere.
+     * @param radius2: float the squared radius of the sphere.
+     * @param t: float the distance to the closest intersection so far, updated on a closer hit.
+     * @return true if the sphere is hit in front of the ray and closer than t, false otherwise.
+     */
+    bool raysphere(const Ray &ray, const vec3 &center, const float &radius2, float &t);
+
+    /**
+     * slab:
+     * -----
+     * the distance along a ray to the plane at coordinate p of an axis,
+     * given the reciprocal direction inv and oinv = orig * inv on that axis.
+     */
+    inline float slab(const float &p, const float &inv, const float &oinv)
+    {
+#ifdef __FMA__
+        return std::fma(p, inv, -oinv);
+#else
+        return p * inv - oinv;
+#endif
+    }
+
+    /**
+     * raybox:
+     * -------
+     * performs a slab test between a ray and an axis aligned box, without
+     * branches.
+     *
+     * @param ray: Ray the incoming ray.
+     * @param bounds: vec3[2] the min and max corners of the box.
+     * @param tmin: float the distance along the ray where it enters the box.
+     * @param tmax: float the distance along the ray where it exits the box.
+     * @return true if the line of the ray crosses the box, false otherwise.
+     * NOTE: tmin and tmax are not clamped, so either may be negative.
+     */
+    inline bool raybox(const Ray &ray, const vec3 bounds[2], float &tmin, float &tmax)
+    {
+        float txmin = slab(bounds[ray.sign[0]].x, ray.invdir.x, ray.oinvdir.x);
+        float txmax = slab(bounds[1 - ray.sign[0]].x, ray.invdir.x, ray.oinvdir.x);
+        float tymin = slab(bounds[ray.sign[1]].y, ray.invdir.y, ray.oinvdir.y);
+        float tymax = slab(bounds[1 - ray.sign[1]].y, ray.invdir.y, ray.oinvdir.y);
+        float tzmin = slab(bounds[ray.sign[2]].z, ray.invdir.z, ray.oinvdir.z);
+        float tzmax = slab(bounds[1 - ray.sign[2]].z, ray.invdir.z, ray.oinvdir.z);
+        tmin = std::max(std::max(txmin, tymin), tzmin);
+        tmax = std::min(std::min(txmax, tymax), tzmax);
+        return tmin <= tmax;
+    }
+
+    /**
+     * raybox:
+     * -------
+     * performs a slab test between a ray and an axis aligned box.
+     *
+     * @param ray: Ray the incoming ray.
+     * @param bounds: vec3[2] the min and max corners of the box.
+     * @param t: float the distance to the closest intersection so far, set to
+     *           where the ray enters the box, or leaves it if the ray starts inside.
+     * @return true if the box is hit in front of the ray and closer than t, false otherwise.
+     */
+    inline bool raybox(const Ray &ray, const vec3 bounds[2], float &t)
+    {
+        float tmin, tmax;
+        bool hit = raybox(ray, bounds, tmin, tmax);
+        float t0 = tmin < 0 ? tmax : tmin;
+        hit = hit & (t0 >= 0) & (t0 <= t);
+        t = hit ? t0 : t;
+        return hit;
+    }
+
+    inline bool raybox(const Ray &ray, const vec3 bounds[2])
+    {
+        float tmin, tmax;
+        return raybox(ray, bounds, tmin, tmax) & (tmax >= 0);
+    }
+
     bool boxbox(const vec3 bounds1[2], const vec3 bounds2[2]);
 
     class BoundingBox: public Shape
@@ -107,6 +220,8 @@ namespace rt
         BoundingBox(Shape *s);
         virtual bool intersect(const Ray &ray, float &t) const;
         virtual void extents(vec3 &emin, vec3 &emax) const;
+        virtual void update();
+        const Shape *getShape() const;
     private:
         vec3 bounds[2];
         Shape *shape;
@@ -115,9 +230,36 @@ namespace rt
     class ShapeContainer
     {
     public:
+        virtual ~ShapeContainer() {}
         virtual bool intersect(const Ray &ray, float &t) const = 0;
+
+        /**
+         * intersectPacket:
+         * ----------------
+         * intersects every ray of a packet, by default one at a time.
+         *
+         * @param packet: RayPacket the incoming rays.
+         * @param t: float[] the distance to the closest intersection so far of each ray.
+         */
+        virtual void intersectPacket(const RayPacket &packet, float *t) const;
         virtual void addShape(Shape * shape) = 0;
         virtual size_t size() const = 0;
+
+        /**
+         * build:
+         * ------
+         * prepares the container for tracing once every shape has been added.
+         */
+        virtual void build() {}
+
+        /**
+         * refit:
+         * ------
+         * brings the container up to date after its shapes moved.
+         *
+         * @return true if the container had to be rebuilt, false if it was refit in place.
+         */
+        virtual bool refit() { build(); return true; }
     };
 
     class LinearContainer: public ShapeContainer
@@ -126,6 +268,8 @@ namespace rt
         virtual bool intersect(const Ray &ray, float &t) const;
         virtual void addShape(Shape *shape);
         virtual size_t size() const;
+        virtual bool refit() { return false; }
+        const std::vector<Shape*> &getShapes() const { return shapes; }
     private:
         std::vector<Shape*>shapes;
     };
@@ -136,28 +280,13 @@ namespace rt
         virtual bool intersect(const Ray &ray, float &t) const;
         virtual void addShape(Shape *shape);
         virtual size_t size() const;
+        virtual bool refit();
     private:
         vec3 bounds[2];
         LinearContainer shapes;
     };
 
 
-    struct OctreeNode
-    {
-        static constexpr size_t MAX_SIZE = 5;
-        static constexpr size_t MAX_DEPTH = 8;
-        vec3 center;
-        std::vector<Shape*> content;
-        std::vector<OctreeNode> children;
-        vec3 bounds[2];
-        size_t depth;
-        OctreeNode(const vec3 &emin, const vec3 &emax, size_t depth);
-        void split();
-        void addShape(Shape *shape);
-        bool intersect(const Ray &ray, float &t) const;
-        bool intersect(Shape *shape) const;
-    };
-
 }; // namespace
 
 
@@ -0,0 +1,119 @@
+#include "thread-pool.hpp"
+
+#include <algorithm>
+
+namespace rt
+{
+    ThreadPool::ThreadPool(const size_t &threads):task(nullptr), remaining(0), generation(0), stopping(false)
+    {
+        size_t n = threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+        for(size_t i = 0;i < n;i++)
+        {
+            queues.emplace_back(new Queue());
+        }
+        for(size_t i = 0;i + 1 < n;i++)
+        {
+            this->threads.push_back(std::thread(&ThreadPool::work, this, i));
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for(auto &thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    size_t ThreadPool::size() const
+    {
+        return queues.size();
+    }
+
+    void ThreadPool::parallelFor(const size_t &n, const std::function<void(size_t)> &task)
+    {
+        if(n == 0) return;
+        std::lock_guard<std::mutex> serial(busy);
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            this->task = &task;
+            remaining = n;
+            // deal out contiguous runs, so neighbouring tasks tend to share a thread.
+            size_t count = queues.size();
+            for(size_t q = 0;q < count;q++)
+            {
+                std::lock_guard<std::mutex> queueGuard(queues[q]->lock);
+                for(size_t i = n * q / count;i < n * (q + 1) / count;i++)
+                {
+                    queues[q]->tasks.push_back(i);
+                }
+            }
+            generation++;
+        }
+        wake.notify_all();
+
+        while(runOne(queues.size() - 1));
+        std::unique_lock<std::mutex> guard(lock);
+        done.wait(guard, [&]{return remaining == 0;});
+    }
+
+    void ThreadPool::work(const size_t &id)
+    {
+        size_t seen = 0;
+        while(true)
+        {
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                wake.wait(guard, [&]{return stopping || generation != seen;});
+                if(stopping) return;
+                seen = generation;
+            }
+            while(runOne(id));
+        }
+    }
+
+    /**
+     * runOne:
+     * -------
+     * runs the next task of a thread's own queue, or one stolen from the back
+     * of another queue.
+     *
+     * @return false if every queue was empty.
+     */
+    bool ThreadPool::runOne(const size_t &id)
+    {
+        size_t count = queues.size();
+        for(size_t k = 0;k < count;k++)
+        {
+            Queue &queue = *queues[(id + k) % count];
+            size_t index;
+            {
+                std::lock_guard<std::mutex> guard(queue.lock);
+                if(queue.tasks.empty()) continue;
+                if(k == 0)
+                {
+                    index = queue.tasks.front();
+                    queue.tasks.pop_front();
+                }
+                else
+                {
+                    index = queue.tasks.back();
+                    queue.tasks.pop_back();
+                }
+            }
+            (*task)(index);
+            if(--remaining == 0)
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                done.notify_all();
+            }
+            return true;
+        }
+        return false;
+    }
+};
@@ -0,0 +1,74 @@
+#ifndef __THREAD_POOL_HPP__
+#define __THREAD_POOL_HPP__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rt
+{
+    /**
+     * ThreadPool:
+     * -----------
+     * a fixed set of worker threads that live as long as the pool, so a frame
+     * does not pay for starting threads.  Every thread owns a queue of tasks
+     * and, once it runs dry, steals from the back of the other queues, which
+     * evens out tasks of very different cost.
+     */
+    class ThreadPool
+    {
+    public:
+        /**
+         * ThreadPool:
+         * -----------
+         * starts the worker threads.
+         *
+         * @param threads: size_t the number of threads that run tasks, including
+         *                 the one calling parallelFor.  0 uses one per hardware thread.
+         */
+        explicit ThreadPool(const size_t &threads=0);
+        ~ThreadPool();
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        /**
+         * parallelFor:
+         * ------------
+         * calls task(i) for every i in [0, n) across the pool, and returns once
+         * all of them are done.  The calling thread runs tasks too.
+         *
+         * @param n: size_t the number of tasks.
+         * @param task: function called with the index of each task, from any thread.
+         * NOTE: a task must not call parallelFor on the same pool.
+         */
+        void parallelFor(const size_t &n, const std::function<void(size_t)> &task);
+
+        size_t size() const;
+    private:
+        struct Queue
+        {
+            std::mutex lock;
+            std::deque<size_t> tasks;
+        };
+
+        void work(const size_t &id);
+        bool runOne(const size_t &id);
+
+        std::vector<std::thread> threads;
+        std::vector<std::unique_ptr<Queue>> queues;     // one per thread, the caller's is the last
+        std::mutex lock, busy;
+        std::condition_variable wake, done;
+        const std::function<void(size_t)> *task;
+        std::atomic<size_t> remaining;
+        size_t generation;
+        bool stopping;
+    };
+};
+
+#endif // __THREAD_POOL_HPP__
@@ -0,0 +1,187 @@
+#include "triangles.hpp"
+
+#include <cstring>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RT_X86
+#endif
+
+namespace rt
+{
+    constexpr int TriangleBlock::WIDTH;
+
+    TriangleBlock::TriangleBlock()
+    {
+        memset(this, 0, sizeof(*this));
+    }
+
+    void TriangleBlock::set(const int &i, const vec3 &a, const vec3 &b, const vec3 &c)
+    {
+        vec3 ab = b - a, ac = c - a;
+        v0[0][i] = a.x; v0[1][i] = a.y; v0[2][i] = a.z;
+        e1[0][i] = ab.x; e1[1][i] = ab.y; e1[2][i] = ab.z;
+        e2[0][i] = ac.x; e2[1][i] = ac.y; e2[2][i] = ac.z;
+    }
+
+#ifdef RT_X86
+    /**
+     * closest:
+     * --------
+     * takes the nearest of the candidate distances whose bit is set in mask.
+     */
+    static bool closest(const float *t0, int mask, float &t)
+    {
+        bool hit = false;
+        for(;mask;mask &= mask - 1)
+        {
+            int i = __builtin_ctz(mask);
+            if(t0[i] <= t)
+            {
+                t = t0[i];
+                hit = true;
+            }
+        }
+        return hit;
+    }
+
+    /**
+     * raytriangles4:
+     * --------------
+     * the SSE kernel, testing the four triangles from slot first on.
+     */
+    static bool raytriangles4(const Ray &ray, const TriangleBlock &block, const int &first, float &t)
+    {
+        __m128 dx = _mm_set1_ps(ray.dir.x), dy = _mm_set1_ps(ray.dir.y), dz = _mm_set1_ps(ray.dir.z);
+        __m128 e1x = _mm_load_ps(block.e1[0] + first), e1y = _mm_load_ps(block.e1[1] + first), e1z = _mm_load_ps(block.e1[2] + first);
+        __m128 e2x = _mm_load_ps(block.e2[0] + first), e2y = _mm_load_ps(block.e2[1] + first), e2z = _mm_load_ps(block.e2[2] + first);
+
+        // pvec = dir x e2, det = e1 . pvec
+        __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+        __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+        __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+        __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+        __m128 absdet = _mm_andnot_ps(_mm_set1_ps(-0.0f), det);
+        __m128 valid = _mm_cmpge_ps(absdet, _mm_set1_ps(std::numeric_limits<float>::epsilon()));
+        if(_mm_movemask_ps(valid) == 0) return false;
+        __m128 idet = _mm_div_ps(_mm_set1_ps(1), det);
+
+        // tvec = orig - v0, u = tvec . pvec / det
+        __m128 tx = _mm_sub_ps(_mm_set1_ps(ray.orig.x), _mm_load_ps(block.v0[0] + first));
+        __m128 ty = _mm_sub_ps(_mm_set1_ps(ray.orig.y), _mm_load_ps(block.v0[1] + first));
+        __m128 tz = _mm_sub_ps(_mm_set1_ps(ray.orig.z), _mm_load_ps(block.v0[2] + first));
+        __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz)), idet);
+
+        // qvec = tvec x e1, v = dir . qvec / det, t0 = e2 . qvec / det
+        __m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+        __m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+        __m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+        __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), idet);
+        __m128 t0 = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), idet);
+
+        __m128 zero = _mm_setzero_ps();
+        valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmple_ps(u, _mm_set1_ps(1))));
+        valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1))));
+        valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(t0, zero), _mm_cmple_ps(t0, _mm_set1_ps(t))));
+        int mask = _mm_movemask_ps(valid);
+        if(mask == 0) return false;
+        alignas(16) float dist[4];
+        _mm_store_ps(dist, t0);
+        return closest(dist, mask, t);
+    }
+
+    static bool raytrianglesSSE(const Ray &ray, const TriangleBlock &block, float &t)
+    {
+        bool hit = raytriangles4(ray, block, 0, t);
+        if(raytriangles4(ray, block, 4, t))
+        {
+            hit = true;
+        }
+        return hit;
+    }
+
+    /**
+     * raytrianglesAVX2:
+     * -----------------
+     * the AVX2 kernel, the same test as the SSE one on all eight slots at once.
+     */
+    __attribute__((target("avx2")))
+    static bool raytrianglesAVX2(const Ray &ray, const TriangleBlock &block, float &t)
+    {
+        __m256 dx = _mm256_set1_ps(ray.dir.x), dy = _mm256_set1_ps(ray.dir.y), dz = _mm256_set1_ps(ray.dir.z);
+        __m256 e1x = _mm256_load_ps(block.e1[0]), e1y = _mm256_load_ps(block.e1[1]), e1z = _mm256_load_ps(block.e1[2]);
+        __m256 e2x = _mm256_load_ps(block.e2[0]), e2y = _mm256_load_ps(block.e2[1]), e2z = _mm256_load_ps(block.e2[2]);
+
+        __m256 px = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+        __m256 py = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+        __m256 pz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+        __m256 det = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, px), _mm256_mul_ps(e1y, py)), _mm256_mul_ps(e1z, pz));
+        __m256 absdet = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), det);
+        __m256 valid = _mm256_cmp_ps(absdet, _mm256_set1_ps(std::numeric_limits<float>::epsilon()), _CMP_GE_OQ);
+        if(_mm256_movemask_ps(valid) == 0) return false;
+        __m256 idet = _mm256_div_ps(_mm256_set1_ps(1), det);
+
+        __m256 tx = _mm256_sub_ps(_mm256_set1_ps(ray.orig.x), _mm256_load_ps(block.v0[0]));
+        __m256 ty = _mm256_sub_ps(_mm256_set1_ps(ray.orig.y), _mm256_load_ps(block.v0[1]));
+        __m256 tz = _mm256_sub_ps(_mm256_set1_ps(ray.orig.z), _mm256_load_ps(block.v0[2]));
+        __m256 u = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(tx, px), _mm256_mul_ps(ty, py)), _mm256_mul_ps(tz, pz)), idet);
+
+        __m256 qx = _mm256_sub_ps(_mm256_mul_ps(ty, e1z), _mm256_mul_ps(tz, e1y));
+        __m256 qy = _mm256_sub_ps(_mm256_mul_ps(tz, e1x), _mm256_mul_ps(tx, e1z));
+        __m256 qz = _mm256_sub_ps(_mm256_mul_ps(tx, e1y), _mm256_mul_ps(ty, e1x));
+        __m256 v = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)), _mm256_mul_ps(dz, qz)), idet);
+        __m256 t0 = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)), _mm256_mul_ps(e2z, qz)), idet);
+
+        __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1);
+        valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_GE_OQ), _mm256_cmp_ps(u, one, _CMP_LE_OQ)));
+        valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(v, zero, _CMP_GE_OQ), _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ)));
+        valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(t0, zero, _CMP_GE_OQ), _mm256_cmp_ps(t0, _mm256_set1_ps(t), _CMP_LE_OQ)));
+        int mask = _mm256_movemask_ps(valid);
+        if(mask == 0) return false;
+        alignas(32) float dist[8];
+        _mm256_store_ps(dist, t0);
+        return closest(dist, mask, t);
+    }
+
+    typedef bool (*TriangleKernel)(const Ray &, const TriangleBlock &, float &);
+
+    static TriangleKernel pickKernel()
+    {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") ? raytrianglesAVX2 : raytrianglesSSE;
+    }
+
+    bool raytriangles(const Ray &ray, const TriangleBlock &block, float &t)
+    {
+        static const TriangleKernel kernel = pickKernel();
+        return kernel(ray, block, t);
+    }
+#else
+    bool raytriangles(const Ray &ray, const TriangleBlock &block, float &t)
+    {
+        bool hit = false;
+        for(int i = 0;i < TriangleBlock::WIDTH;i++)
+        {
+            vec3 a = {block.v0[0][i], block.v0[1][i], block.v0[2][i]};
+            vec3 ab = {block.e1[0][i], block.e1[1][i], block.e1[2][i]};
+            vec3 ac = {block.e2[0][i], block.e2[1][i], block.e2[2][i]};
+            vec3 pvec = cross(ray.dir, ac);
+            float det = dot(ab, pvec);
+            if(fabs(det) < std::numeric_limits<float>::epsilon()) continue;
+            float idet = 1 / det;
+            vec3 tvec = ray.orig - a;
+            float u = dot(tvec, pvec) * idet;
+            if(u < 0 || u > 1) continue;
+            vec3 qvec = cross(tvec, ab);
+            float v = dot(ray.dir, qvec) * idet;
+            if(v < 0 || u + v > 1) continue;
+            float t0 = dot(ac, qvec) * idet;
+            if(t0 < 0 || t0 > t) continue;
+            t = t0;
+            hit = true;
+        }
+        return hit;
+    }
+#endif
+};
@@ -0,0 +1,55 @@
+#ifndef __TRIANGLES_HPP__
+#define __TRIANGLES_HPP__
+
+#include "vec3.hpp"
+#include "ray.hpp"
+
+#include <cstdint>
+
+namespace rt
+{
+    /**
+     * TriangleBlock:
+     * --------------
+     * up to eight triangles stored one component at a time, with the edges
+     * from the first vertex precomputed, so a ray can be tested against all of
+     * them at once.  Unused slots have zero edges, which no ray can hit.
+     */
+    struct alignas(32) TriangleBlock
+    {
+        static constexpr int WIDTH = 8;
+        float v0[3][WIDTH];
+        float e1[3][WIDTH];
+        float e2[3][WIDTH];
+
+        TriangleBlock();
+
+        /**
+         * set:
+         * ----
+         * stores a triangle in one of the slots.
+         *
+         * @param i: int the slot.
+         * @param a: vec3 the first vertex.
+         * @param b: vec3 the second vertex.
+         * @param c: vec3 the third vertex.
+         */
+        void set(const int &i, const vec3 &a, const vec3 &b, const vec3 &c);
+    };
+
+    /**
+     * raytriangles:
+     * -------------
+     * performs a Moller-Trumbore intersection test between a ray and every
+     * triangle of a block.  Uses AVX2 when the cpu has it, SSE otherwise.
+     *
+     * @param ray: Ray the incoming ray.
+     * @param block: TriangleBlock the triangles.
+     * @param t: float the distance to the closest intersection so far, updated on a closer hit.
+     * @return true if any triangle is hit in front of the ray and closer than t, false otherwise.
+     */
+    bool raytriangles(const Ray &ray, const TriangleBlock &block, float &t);
+
+}; // namespace
+
+#endif // __TRIANGLES_HPP__
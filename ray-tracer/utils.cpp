@@ -1,10 +1,14 @@
 #include "utils.hpp"
+#include "random.hpp"
 #include <limits>
 
 #include <iostream>
 #include <cmath>
 
+#include <cstring>
+#include <filesystem>
 #include <fstream>
+#include <unistd.h>
 
 namespace rt
 {
@@ -19,35 +23,48 @@ namespace rt
     }
 
     float *normalize(float *pix, const int &size, bool invert)
+    {
+        normalize(pix, size, 1, size, invert);
+    	return pix;
+    }
+
+    void normalize(float *pix, const int &width, const int &height, const size_t &stride, bool invert)
     {
     	float minval = std::numeric_limits<float>::max(), maxval = 0;
-    	for(int i = 0;i < size;i++)
+    	for(int j = 0;j < height;j++)
     	{
-    		float p = pix[i];
-    		if(p > 0 && p < minval)
-    		{
-    			minval = p;
-    		}
-    		if(p > maxval)
+    		const float *row = pix + j * stride;
+    		for(int i = 0;i < width;i++)
     		{
-    			maxval = p;
+    			float p = row[i];
+    			if(p > 0 && p < minval)
+    			{
+    				minval = p;
+    			}
+    			if(p > maxval)
+    			{
+    				maxval = p;
+    			}
     		}
     	}
-    	for(int i =0;i < size;i++)
+    	for(int j = 0;j < height;j++)
     	{
-            if(pix[i] != 0)
-            {
-                if(invert)
-                {
-                    pix[i] = 1 - ((pix[i] - minval) / (maxval - minval)); 
-                }
-                else
+    		float *row = pix + j * stride;
+    		for(int i = 0;i < width;i++)
+    		{
+                if(row[i] != 0)
                 {
-                    pix[i] = ((pix[i] - minval) / (maxval - minval));
+                    if(invert)
+                    {
+                        row[i] = 1 - ((row[i] - minval) / (maxval - minval)); 
+                    }
+                    else
+                    {
+                        row[i] = ((row[i] - minval) / (maxval - minval));
+                    }
                 }
-            }
+    		}
     	}
-    	return pix;
     }
 
     unsigned char *touchar(float *pix, const int &size)
@@ -60,13 +77,57 @@ namespace rt
     	return res;
     }
 
-    void toPPM(const std::string &filename, unsigned char *pix, const int &width, const int &height)
+    uint64_t hashBytes(const char *data, const size_t &size, const uint64_t &seed)
     {
-    	std::ofstream f(filename);
-    	f << "P3\n" << width << " " << height << "\n255\n";
-    	for(int i = 0;i < width * height;i++)
-    	{
-    		f << (int) pix[i];
-    	}
+        // every 8 byte word is folded in through the splitmix64 finalizer, so each
+        // of its bits reaches every bit of the hash before the next word comes in.
+        uint64_t h = mix64(0x9E3779B97F4A7C15ull ^ seed);
+        size_t i = 0;
+        for(;i + 8 <= size;i += 8)
+        {
+            uint64_t word;
+            memcpy(&word, data + i, 8);
+            h = mix64(h ^ word);
+        }
+        if(i < size)
+        {
+            uint64_t word = 0;
+            memcpy(&word, data + i, size - i);
+            h = mix64(h ^ word);
+        }
+        return mix64(h ^ size);
+    }
+
+    bool writeFile(const std::string &filename, const std::function<void(std::ofstream &)> &write)
+    {
+        std::error_code ec;
+        std::filesystem::path path(filename);
+        if(path.has_parent_path())
+        {
+            std::filesystem::create_directories(path.parent_path(), ec);
+        }
+
+        std::string tmp = filename + "." + std::to_string(getpid()) + ".tmp";
+        {
+            std::ofstream f(tmp, std::ios::binary);
+            if(!f.is_open())
+            {
+                return false;
+            }
+            write(f);
+            if(!f.good())
+            {
+                f.close();
+                std::remove(tmp.c_str());
+                return false;
+            }
+        }
+        std::filesystem::rename(tmp, filename, ec);
+        if(ec)
+        {
+            std::remove(tmp.c_str());
+            return false;
+        }
+        return true;
     }
 };
\ No newline at end of file
@@ -1,6 +1,10 @@
 #ifndef __UTILS_HPP__
 #define __UTILS_HPP__
 
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
 #include <string>
 
 namespace rt
@@ -29,7 +33,43 @@ namespace rt
 
     float *normalize(float *pix, const int &size, bool invert=false);
 
-    void toPPM(const std::string &filename, unsigned char *pix, const int &size);
+    /**
+     * normalize:
+     * ----------
+     * rescales the nonzero distances of an image in place to [0, 1], from
+     * the nearest to the farthest, leaving misses at 0.
+     *
+     * @param pix: float* the first pixel of the image.
+     * @param width: int the number of pixels in a row.
+     * @param height: int the number of rows.
+     * @param stride: size_t the number of floats from the start of one row to the next.
+     * @param invert: bool maps the nearest distance to 1 and the farthest to 0 instead.
+     */
+    void normalize(float *pix, const int &width, const int &height, const size_t &stride, bool invert=false);
+
+    /**
+     * hashBytes:
+     * ----------
+     * a fast 64 bit hash of a block of memory, used to key cached files.
+     *
+     * @param data: char* the start of the memory.
+     * @param size: size_t the number of bytes to hash.
+     * @param seed: uint64_t mixed into the hash, to tell apart different kinds of data.
+     * @return the hash of the bytes.
+     */
+    uint64_t hashBytes(const char *data, const size_t &size, const uint64_t &seed=0);
+
+    /**
+     * writeFile:
+     * ----------
+     * writes a file next to its destination and renames it into place, so
+     * concurrent renders never see a partial file.  Missing directories are created.
+     *
+     * @param filename: string the name of the file.
+     * @param write: function writing the contents to the stream it is given.
+     * @return true if the file was written, false otherwise.
+     */
+    bool writeFile(const std::string &filename, const std::function<void(std::ofstream &)> &write);
 };
 
 
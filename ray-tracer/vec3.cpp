@@ -13,51 +13,4 @@ namespace rt
         is.ignore(256, ')');
         return is;
     }
-    vec3 operator+(const vec3 &a, const vec3 &b)
-    {
-        return {a.x + b.x, a.y + b.y, a.z + b.z};
-    }
-    vec3 operator-(const vec3 &a, const vec3 &b)
-    {
-        return {a.x - b.x, a.y - b.y, a.z - b.z};
-    }
-    vec3 operator*(const vec3 &a, const float &f)
-    {
-        return {a.x * f, a.y * f, a.z * f};
-    }
-    vec3 operator/(const vec3 &a, const float &f)
-    {
-        return {a.x / f, a.y / f, a.z / f};
-    }
-    vec3 operator/(const float &f, const vec3 &a)
-    {
-        return {f / a.x, f / a.y, f / a.z};   
-    }
-    float dot(const vec3 &a, const vec3 &b)
-    {
-        return a.x * b.x + a.y * b.y + a.z * b.z;
-    }
-    vec3 cross(const vec3 &a, const vec3 &b)
-    {
-        return 
-        {
-            a.y * b.z - a.z * b.y,
-            a.z * b.x - a.x * b.z,
-            a.x * b.y - a.y * b.x
-        };
-    }
-    vec3 norm(const vec3 &a)
-    {
-        return a / sqrtf(dot(a, a));
-    }
-
-    float min(const vec3 &v)
-    {
-        return v.x < v.y && v.x < v.z ? v.x : v.y < v.z ? v.y : v.z;
-    }
-
-    float max(const vec3 &v)
-    {
-        return v.x > v.y && v.x > v.z ? v.x : v.y > v.z ? v.y : v.z;
-    }
-};
\ No newline at end of file
+};
@@ -9,7 +9,8 @@ namespace rt
     /**
      * vec3:
      * -----
-     * The basic 3d vector structure
+     * The basic 3d vector structure. All of the arithmetic below is
+     * defined inline so that it can be folded into the intersection loops.
      */
     typedef struct vec3
     {
@@ -26,7 +27,10 @@ namespace rt
      * @param b: vec3 the right operand
      * @return the elementwise addition of two vec3's
      */
-    vec3 operator+(const vec3 &a, const vec3 &b);
+    constexpr vec3 operator+(const vec3 &a, const vec3 &b)
+    {
+        return {a.x + b.x, a.y + b.y, a.z + b.z};
+    }
 
     /**
      * operator-:
@@ -37,7 +41,10 @@ namespace rt
      * @param b: vec3 the right operand
      * @return the elementwise subtraction of two vec3's
      */
-    vec3 operator-(const vec3 &a, const vec3 &b);
+    constexpr vec3 operator-(const vec3 &a, const vec3 &b)
+    {
+        return {a.x - b.x, a.y - b.y, a.z - b.z};
+    }
 
     /**
      * operator*:
@@ -48,7 +55,10 @@ namespace rt
      * @param f: float the right operand
      * @return the elementwise multiplication between a vec3 and a float
      */
-    vec3 operator*(const vec3 &a, const float &f);
+    constexpr vec3 operator*(const vec3 &a, const float &f)
+    {
+        return {a.x * f, a.y * f, a.z * f};
+    }
 
     /**
      * operator/:
@@ -59,8 +69,14 @@ namespace rt
      * @param f: float the right operand
      * @return the elementwise division between a vec3 and a float
      */
-    vec3 operator/(const vec3 &a, const float &f);
-    vec3 operator/(const float &f, const vec3 &a);
+    constexpr vec3 operator/(const vec3 &a, const float &f)
+    {
+        return {a.x / f, a.y / f, a.z / f};
+    }
+    constexpr vec3 operator/(const float &f, const vec3 &a)
+    {
+        return {f / a.x, f / a.y, f / a.z};
+    }
 
     /**
      * dot:
@@ -71,7 +87,10 @@ namespace rt
      * @param b: vec3 the right operand
      * @return the dot product between a and b.
      */
-    float dot(const vec3 &a, const vec3 &b);
+    constexpr float dot(const vec3 &a, const vec3 &b)
+    {
+        return a.x * b.x + a.y * b.y + a.z * b.z;
+    }
 
     /**
      * cross:
@@ -82,7 +101,15 @@ namespace rt
      * @param b: vec3 the right operand
      * @return the cross product between a and b.
      */
-    vec3 cross(const vec3 &a, const vec3 &b);
+    constexpr vec3 cross(const vec3 &a, const vec3 &b)
+    {
+        return
+        {
+            a.y * b.z - a.z * b.y,
+            a.z * b.x - a.x * b.z,
+            a.x * b.y - a.y * b.x
+        };
+    }
 
     /*
      * norm:
@@ -92,10 +119,20 @@ namespace rt
      * @param a: vec3 the given vec3
      * @return: the normalized version of a
      */
-    vec3 norm(const vec3 &a);
+    inline vec3 norm(const vec3 &a)
+    {
+        return a / sqrtf(dot(a, a));
+    }
 
-    float min(const vec3 &v);
-    float max(const vec3 &v);
+    constexpr float min(const vec3 &v)
+    {
+        return v.x < v.y && v.x < v.z ? v.x : v.y < v.z ? v.y : v.z;
+    }
+
+    constexpr float max(const vec3 &v)
+    {
+        return v.x > v.y && v.x > v.z ? v.x : v.y > v.z ? v.y : v.z;
+    }
 
 }; // namespace
 
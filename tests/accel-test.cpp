@@ -0,0 +1,127 @@
+#include "../ray-tracer/ray-tracing-scene.hpp"
+#include "../ray-tracer/random.hpp"
+
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace rt;
+
+/**
+ * SceneCase:
+ * ----------
+ * a small scene, made of shapes added to an empty scene, and the eye it is
+ * seen from.  The camera sits at -eye and looks towards the centre, so the
+ * shapes lie around z = -2.
+ */
+struct SceneCase
+{
+    std::string name;
+    vec3 eye;
+    std::function<void(RayTracingScene &)> fill;
+};
+
+static vec3 randomPoint(Random &random, const float &spread, const float &depth)
+{
+    return {random.uniform(-spread, spread), random.uniform(-spread, spread), depth + random.uniform(-spread, spread)};
+}
+
+static const std::vector<SceneCase> SCENES = {
+    {"mixed", {0, 0, -1}, [](RayTracingScene &scene)
+    {
+        Random random(1);
+        for(int i = 0;i < 200;i++)
+        {
+            scene.addShape(new Sphere(randomPoint(random, 1, -2), random.uniform(0.01f, 0.1f)));
+            vec3 a = randomPoint(random, 1, -2);
+            scene.addShape(new Triangle(a, a + randomPoint(random, 0.2f, 0), a + randomPoint(random, 0.2f, 0)));
+        }
+    }},
+    // every triangle lies in the plane z = -2, facing the camera, many of them across the centre planes.
+    {"coplanar", {0, 0, -1}, [](RayTracingScene &scene)
+    {
+        Random random(2);
+        for(int i = 0;i < 500;i++)
+        {
+            vec3 a = {random.uniform(-1, 1), random.uniform(-1, 1), -2};
+            scene.addShape(new Triangle(a, a + vec3{random.uniform(-0.5f, 0.5f), random.uniform(-0.5f, 0.5f), 0}, a + vec3{random.uniform(-0.5f, 0.5f), random.uniform(-0.5f, 0.5f), 0}));
+        }
+    }},
+    // a floor of triangles in the plane y = -0.5, seen at a grazing angle.
+    {"floor", {0, -0.2f, -1}, [](RayTracingScene &scene)
+    {
+        for(int i = 0;i < 25;i++)
+        {
+            for(int j = 0;j < 10;j++)
+            {
+                float x = -2 + i * 0.16f, z = -j * 0.5f;
+                scene.addShape(new Triangle({x, -0.5f, z}, {x + 0.16f, -0.5f, z}, {x, -0.5f, z - 0.5f}));
+                scene.addShape(new Triangle({x + 0.16f, -0.5f, z}, {x + 0.16f, -0.5f, z - 0.5f}, {x, -0.5f, z - 0.5f}));
+            }
+        }
+    }},
+    // large triangles spanning many cells among small spheres, with the camera inside their bounds.
+    {"inside", {0, 0, -1}, [](RayTracingScene &scene)
+    {
+        Random random(3);
+        for(int i = 0;i < 8;i++)
+        {
+            scene.addShape(new Triangle(randomPoint(random, 3, 0), randomPoint(random, 3, 0), randomPoint(random, 3, 0)));
+        }
+        for(int i = 0;i < 300;i++)
+        {
+            scene.addShape(new Sphere(randomPoint(random, 2, 0), random.uniform(0.01f, 0.05f)));
+        }
+    }},
+};
+
+static const std::vector<std::string> ACCELS = {"bvh", "lbvh", "sbvh", "octree", "grid", "massbox"};
+
+static std::vector<float> render(const SceneCase &c, const std::string &accel, const bool &packets)
+{
+    RayTracingScene scene(64, 48, 60);
+    scene.setEye(c.eye);
+    scene.setAccel(accel);
+    scene.setPackets(packets);
+    c.fill(scene);
+    scene.build();
+    std::vector<float> pix(scene.getDims());
+    scene.getDistances(pix.data(), scene.getWidth());
+    return pix;
+}
+
+int main()
+{
+    int failures = 0;
+    for(const auto &c : SCENES)
+    {
+        std::vector<float> expected = render(c, "linear", false);
+        size_t hits = 0;
+        for(auto d : expected) hits += d > 0;
+        for(const auto &accel : ACCELS)
+        {
+            for(bool packets : {false, true})
+            {
+                std::vector<float> pix = render(c, accel, packets);
+                size_t wrong = 0;
+                for(size_t i = 0;i < pix.size();i++)
+                {
+                    // coplanar ties may be resolved by a different shape, a hair apart.
+                    if((pix[i] > 0) != (expected[i] > 0) || std::fabs(pix[i] - expected[i]) > 1e-4f * std::max(1.0f, expected[i]))
+                    {
+                        wrong++;
+                    }
+                }
+                if(wrong > 0 || hits == 0)
+                {
+                    std::cerr << c.name << " " << accel << (packets ? " packets" : "") << ": " << wrong << " of " << pix.size() << " pixels differ from linear (" << hits << " hits)" << std::endl;
+                    failures++;
+                }
+            }
+        }
+    }
+    std::cout << (failures == 0 ? "passed" : "FAILED") << std::endl;
+    return failures == 0 ? 0 : 1;
+}
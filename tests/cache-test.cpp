@@ -0,0 +1,259 @@
+#include "../ray-tracer/ray-tracing-scene.hpp"
+#include "../ray-tracer/random.hpp"
+#include "../ray-tracer/utils.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+using namespace rt;
+
+static int failures = 0;
+
+static void check(const bool &ok, const std::string &what)
+{
+    if(!ok)
+    {
+        std::cerr << what << std::endl;
+        failures++;
+    }
+}
+
+static std::filesystem::path dir;
+
+// writes a binary mesh of one triangle facing the camera, whose corners are moved by offset.
+static void writeMesh(const std::string &filename, const vec3 &offset)
+{
+    TriangleMesh mesh;
+    mesh.addTriangle(vec3{-1, -1, 0} + offset, vec3{1, -1, 0} + offset, vec3{0, 1, 0} + offset);
+    mesh.saveBinary(filename);
+}
+
+static std::vector<float> render(RayTracingScene &scene)
+{
+    std::vector<float> pix(scene.getDims());
+    scene.getDistances(pix.data(), scene.getWidth());
+    return pix;
+}
+
+// the distance to the mesh in a scene, through the centre of the image.
+static float trace(const std::string &filename, const std::string &cacheDir, const std::string &accel="bvh")
+{
+    RayTracingScene scene(8, 8, 60);
+    scene.setCacheDir(cacheDir);
+    scene.setAccel(accel);
+    scene.addObj(filename);
+    scene.build();
+    return render(scene)[4 * 8 + 4];
+}
+
+/**
+ * CacheCase:
+ * ----------
+ * a change to a mesh file between two renders, which the second render has to see.
+ */
+struct CacheCase
+{
+    std::string name;
+    std::function<void(const std::string &)> change;
+};
+
+static void writeFlipped(const std::string &filename)
+{
+    TriangleMesh mesh;
+    mesh.addTriangle({1, -1, -0.25f}, {-1, -1, 0}, {0, 1, -0.25f});
+    mesh.saveBinary(filename);
+}
+
+static const std::vector<CacheCase> CHANGES = {
+    {"moved", [](const std::string &f){writeMesh(f, {0, 0, -0.5f});}},
+    // the same size, with the signs of two words flipped.
+    {"signs flipped", writeFlipped},
+};
+
+/**
+ * StampCase:
+ * ----------
+ * a change to a mesh file, and whether the process cache, which goes by
+ * modification time and size rather than contents, has to see it.
+ */
+struct StampCase
+{
+    std::string name;
+    std::function<void(const std::string &)> change;
+    bool seen;
+};
+
+static void keepTime(const std::string &filename, const std::function<void()> &change, const int &seconds)
+{
+    auto mtime = std::filesystem::last_write_time(filename);
+    change();
+    std::filesystem::last_write_time(filename, mtime + std::chrono::seconds(seconds));
+}
+
+static const std::vector<StampCase> STAMPS = {
+    {"same time and size", [](const std::string &f){keepTime(f, [&]{writeFlipped(f);}, 0);}, false},
+    {"newer time", [](const std::string &f){keepTime(f, [&]{writeFlipped(f);}, 2);}, true},
+    // moved, with a second triangle out of sight.
+    {"other size", [](const std::string &f)
+    {
+        keepTime(f, [&]
+        {
+            TriangleMesh mesh;
+            mesh.addTriangle({-1, -1, -0.5f}, {1, -1, -0.5f}, {0, 1, -0.5f});
+            mesh.addTriangle({10, 10, 10}, {11, 10, 10}, {10, 11, 10});
+            mesh.saveBinary(f);
+        }, 0);
+    }, true},
+};
+
+/**
+ * TreeCase:
+ * ---------
+ * damage to the BVH of a cache file that FromCache has to reject rather
+ * than collapse or trace.  A cache file is a 72 byte header followed by the
+ * vertex, face, node and index arrays; a node is 32 bytes, with the second
+ * child of an interior node at byte 24.
+ */
+struct TreeCase
+{
+    std::string name;
+    std::function<void(std::string &, const size_t &, const uint64_t &)> damage;
+};
+
+static void setOffset(std::string &bytes, const size_t &node, const uint32_t &offset)
+{
+    memcpy(&bytes[node + 24], &offset, sizeof(offset));
+}
+
+static const std::vector<TreeCase> TREES = {
+    {"root pointing at itself", [](std::string &b, const size_t &nodes, const uint64_t &){setOffset(b, nodes, 0);}},
+    {"root pointing past the end", [](std::string &b, const size_t &nodes, const uint64_t &count){setOffset(b, nodes, count);}},
+    {"both children the same node", [](std::string &b, const size_t &nodes, const uint64_t &){setOffset(b, nodes, 1);}},
+    // the first child of the root is interior too, so node 2 is its first child.
+    {"a node reached twice", [](std::string &b, const size_t &nodes, const uint64_t &){setOffset(b, nodes, 2);}},
+    {"unknown build mode", [](std::string &b, const size_t &, const uint64_t &){uint32_t mode = 7; memcpy(&b[12], &mode, sizeof(mode));}},
+    {"no nodes", [](std::string &b, const size_t &nodes, const uint64_t &count)
+    {
+        b.erase(nodes, count * 32);
+        uint64_t none = 0;
+        memcpy(&b[56], &none, sizeof(none));
+    }},
+};
+
+int main()
+{
+    dir = std::filesystem::temp_directory_path() / ("ray-nbow-cache-test-" + std::to_string(getpid()));
+    std::filesystem::create_directories(dir);
+
+    // two flips in the same bit of different words must not cancel out.
+    float a[8] = {1, 2, 3, 4, 5, 6, 7, 8}, b[8] = {1, -2, 3, 4, 5, 6, 7, -8};
+    check(hashBytes(reinterpret_cast<char *>(a), sizeof(a)) != hashBytes(reinterpret_cast<char *>(b), sizeof(b)), "hash: sign flips cancel out");
+    std::set<uint64_t> hashes;
+    char bytes[40] = {};
+    size_t flips = 0;
+    for(size_t i = 0;i < sizeof(bytes) * 8;i++)
+    {
+        for(size_t j = i;j < sizeof(bytes) * 8;j++)
+        {
+            bytes[i / 8] ^= 1 << (i % 8);
+            if(j != i) bytes[j / 8] ^= 1 << (j % 8);
+            hashes.insert(hashBytes(bytes, sizeof(bytes)));
+            bytes[i / 8] ^= 1 << (i % 8);
+            if(j != i) bytes[j / 8] ^= 1 << (j % 8);
+            flips++;
+        }
+    }
+    check(hashes.size() == flips, "hash: " + std::to_string(flips - hashes.size()) + " collisions between one and two bit flips");
+
+    // the disk cache is keyed by contents, so a changed file is never read from a stale cache file.
+    std::string cacheDir = (dir / "cache").string();
+    for(const auto &change : CHANGES)
+    {
+        std::string file = (dir / ("mesh-" + std::to_string(&change - CHANGES.data()) + TriangleMesh::BINARY_EXTENSION)).string();
+        writeMesh(file, {0, 0, 0});
+        float before = trace(file, cacheDir);
+        check(before > 0 && trace(file, cacheDir) == before, change.name + ": the cached mesh differs from the file");
+        change.change(file);
+        MeshCache::global().clear();
+        std::string fresh = (dir / "no-cache").string();
+        float expected = trace(file, fresh);
+        MeshCache::global().clear();
+        check(trace(file, cacheDir) == expected && expected != before, change.name + ": a stale mesh was read from the disk cache");
+    }
+
+    // a cache file whose BVH is not a tree is rejected before it is collapsed.
+    TriangleMesh built;
+    Random random(4);
+    for(int i = 0;i < 300;i++)
+    {
+        vec3 a = {random.uniform(-1, 1), random.uniform(-1, 1), random.uniform(-1, 1)};
+        built.addTriangle(a, a + vec3{0.1f, 0, 0}, a + vec3{0, 0.1f, 0});
+    }
+    built.build();
+    std::string cacheFile = (dir / "tree.rtmesh").string();
+    built.save(cacheFile, 1, 2);
+    std::ifstream in(cacheFile, std::ios::binary);
+    std::string image((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    uint64_t vertices, faces, nodes;
+    memcpy(&vertices, &image[40], sizeof(vertices));
+    memcpy(&faces, &image[48], sizeof(faces));
+    memcpy(&nodes, &image[56], sizeof(nodes));
+    size_t nodeStart = 72 + vertices * 12 + faces * 4;
+    TriangleMesh *loaded = TriangleMesh::FromCache(cacheFile, 1, 2);
+    check(loaded != nullptr && image[nodeStart + 28] == 0 && image[nodeStart + 32 + 28] == 0, "tree: the undamaged file did not load, or its first nodes are leaves");
+    delete loaded;
+    for(const auto &tree : TREES)
+    {
+        std::string bad = image;
+        tree.damage(bad, nodeStart, nodes);
+        std::ofstream(cacheFile, std::ios::binary).write(bad.data(), bad.size());
+        loaded = TriangleMesh::FromCache(cacheFile, 1, 2);
+        check(loaded == nullptr, "tree: accepted a damaged cache file (" + tree.name + ")");
+        delete loaded;
+    }
+
+    // the process cache reloads a file once its time or size changes.
+    for(const auto &stamp : STAMPS)
+    {
+        std::string file = (dir / ("stamp-" + std::to_string(&stamp - STAMPS.data()) + TriangleMesh::BINARY_EXTENSION)).string();
+        writeMesh(file, {0, 0, 0});
+        float before = trace(file, "");
+        stamp.change(file);
+        check((trace(file, "") != before) == stamp.seen, stamp.name + ": the process cache " + (stamp.seen ? "kept a stale mesh" : "reloaded an unchanged file"));
+    }
+
+    // scenes with the same accel share a build, other accels get their own, and no scene's mesh is rebuilt under it.
+    MeshCache::global().clear();
+    std::string file = (dir / ("shared" + std::string(TriangleMesh::BINARY_EXTENSION))).string();
+    writeMesh(file, {0, 0, 0});
+    RayTracingScene first(8, 8, 60), second(8, 8, 60), third(8, 8, 60);
+    first.setAccel("bvh");
+    first.addObj(file);
+    first.build();
+    std::vector<float> expected = render(first);
+    second.setAccel("bvh");
+    second.addObj(file);
+    second.build();
+    check(MeshCache::global().size() == 1 && render(second) == expected, "shared: a scene with the same accel loaded the mesh again");
+    third.setAccel("sbvh");
+    third.addObj(file);
+    third.build();
+    second.setAccel("lbvh");
+    second.build();
+    check(MeshCache::global().size() == 3, "shared: " + std::to_string(MeshCache::global().size()) + " builds cached rather than one per accel");
+    check(render(first) == expected && render(second) == expected && render(third) == expected, "shared: another accel changed a scene's mesh");
+
+    std::filesystem::remove_all(dir);
+    std::cout << (failures == 0 ? "passed" : "FAILED") << std::endl;
+    return failures == 0 ? 0 : 1;
+}
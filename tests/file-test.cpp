@@ -0,0 +1,124 @@
+#include "../ray-tracer/mesh.hpp"
+#include "../ray-tracer/random.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+using namespace rt;
+
+/**
+ * FileCase:
+ * ---------
+ * a file format: how to save a mesh to it and load it back, and where the
+ * counts in its header are, which a damaged file could make overflow.
+ */
+struct FileCase
+{
+    std::string name;
+    std::function<bool(const TriangleMesh &, const std::string &)> save;
+    std::function<TriangleMesh *(const std::string &)> load;
+    std::vector<size_t> counts;     // byte offsets of the 64 bit counts in the header
+};
+
+static constexpr uint64_t KEY = 0x1234, SOURCE_SIZE = 5678;
+
+static const std::vector<FileCase> FORMATS = {
+    {"rtmesh",
+        [](const TriangleMesh &mesh, const std::string &f){return mesh.save(f, KEY, SOURCE_SIZE);},
+        [](const std::string &f){return TriangleMesh::FromCache(f, KEY, SOURCE_SIZE);},
+        {40, 48, 56, 64}},
+    {"bmesh",
+        [](const TriangleMesh &mesh, const std::string &f){return mesh.saveBinary(f);},
+        [](const std::string &f){return TriangleMesh::FromBinary(f);},
+        {16, 24}},
+};
+
+static std::string readAll(const std::string &filename)
+{
+    std::ifstream f(filename, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+}
+
+static void writeAll(const std::string &filename, const std::string &data)
+{
+    std::ofstream f(filename, std::ios::binary);
+    f.write(data.data(), data.size());
+}
+
+int main()
+{
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / ("ray-nbow-file-test-" + std::to_string(getpid()));
+    std::filesystem::create_directories(dir);
+
+    TriangleMesh mesh;
+    Random random(3);
+    for(int i = 0;i < 300;i++)
+    {
+        vec3 a = {random.uniform(-1, 1), random.uniform(-1, 1), random.uniform(-1, 1)};
+        mesh.addTriangle(a, a + vec3{random.uniform(0, 0.2f), 0, 0}, a + vec3{0, random.uniform(0, 0.2f), 0});
+    }
+    mesh.build();
+
+    int failures = 0;
+    auto check = [&](const bool &ok, const std::string &what)
+    {
+        if(!ok)
+        {
+            std::cerr << what << std::endl;
+            failures++;
+        }
+    };
+    for(const auto &format : FORMATS)
+    {
+        std::string file = (dir / ("mesh." + format.name)).string(), copy = file + ".copy";
+        check(format.save(mesh, file), format.name + ": save failed");
+        std::string bytes = readAll(file);
+
+        // a loaded file saves back to the same bytes.
+        TriangleMesh *loaded = format.load(file);
+        check(loaded != nullptr && loaded->size() == mesh.size(), format.name + ": load failed");
+        if(loaded != nullptr)
+        {
+            check(format.save(*loaded, copy) && readAll(copy) == bytes, format.name + ": round trip changed the file");
+            delete loaded;
+        }
+
+        std::vector<std::pair<std::string, std::string>> damaged = {
+            {"empty", ""},
+            {"header only", bytes.substr(0, 16)},
+            {"truncated", bytes.substr(0, bytes.size() / 2)},
+            {"one byte short", bytes.substr(0, bytes.size() - 1)},
+            {"one byte long", bytes + 'x'},
+            {"bad magic", "X" + bytes.substr(1)},
+        };
+        for(auto offset : format.counts)
+        {
+            // counts that wrap around to a small size, or to the right one, when multiplied by an element size.
+            uint64_t actual;
+            memcpy(&actual, &bytes[offset], sizeof(actual));
+            for(uint64_t count : {~0ull, (1ull << 62) + 1, 0x5555555555555556ull, actual + (1ull << 62)})
+            {
+                std::string bad = bytes;
+                memcpy(&bad[offset], &count, sizeof(count));
+                damaged.push_back({"count at " + std::to_string(offset), bad});
+            }
+        }
+        for(const auto &d : damaged)
+        {
+            writeAll(copy, d.second);
+            TriangleMesh *bad = format.load(copy);
+            check(bad == nullptr, format.name + ": accepted a damaged file (" + d.first + ")");
+            delete bad;
+        }
+    }
+
+    std::filesystem::remove_all(dir);
+    std::cout << (failures == 0 ? "passed" : "FAILED") << std::endl;
+    return failures == 0 ? 0 : 1;
+}
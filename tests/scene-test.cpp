@@ -0,0 +1,181 @@
+#include "../ray-tracer/ray-tracing-scene.hpp"
+#include "../ray-tracer/scene-tokenizer.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+using namespace rt;
+
+/**
+ * TokenCase:
+ * ----------
+ * the text of a scene file and the reads that have to succeed, or fail, on it.
+ */
+struct TokenCase
+{
+    std::string name;
+    std::string text;
+    std::function<bool(SceneTokenizer &)> read;
+};
+
+static const std::vector<TokenCase> TOKENS = {
+    {"labels", "  WIDTH\tHeight\n", [](SceneTokenizer &f)
+    {
+        std::string a, b, c;
+        return f.label(a) && f.label(b) && !f.label(c) && a == "width" && b == "height" && f.eof();
+    }},
+    {"numbers", "+3 -2 1e3 -.5 +0.25", [](SceneTokenizer &f)
+    {
+        int i, j;
+        float x, y, z;
+        return (f >> i >> j >> x >> y >> z) && i == 3 && j == -2 && x == 1000 && y == -0.5f && z == 0.25f;
+    }},
+    {"vector", "(1, +2,-3.5) ( 4 ,5 , 6 )", [](SceneTokenizer &f)
+    {
+        vec3 a, b;
+        return (f >> a >> b) && a.x == 1 && a.y == 2 && a.z == -3.5f && b.x == 4 && b.z == 6;
+    }},
+    {"crlf lines", "a\r\nb\r\nc", [](SceneTokenizer &f)
+    {
+        std::string a, b;
+        return f.label(a) && f.label(b) && b == "b" && f.line() == 2;
+    }},
+    {"int overflow", "99999999999", [](SceneTokenizer &f)
+    {
+        int i;
+        return !(f >> i);
+    }},
+    {"negative size", "-1", [](SceneTokenizer &f)
+    {
+        size_t i;
+        return !(f >> i);
+    }},
+    {"bad vector", "(1 2 3)", [](SceneTokenizer &f)
+    {
+        vec3 v;
+        return !(f >> v);
+    }},
+    {"failed reads stick", "x 1", [](SceneTokenizer &f)
+    {
+        int i;
+        std::string word;
+        return !(f >> i) && !f.label(word) && !f.eof();
+    }},
+};
+
+static std::string readAll(const std::string &filename)
+{
+    std::ifstream f(filename, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+}
+
+static void writeAll(const std::string &filename, const std::string &data)
+{
+    std::ofstream f(filename, std::ios::binary);
+    f.write(data.data(), data.size());
+}
+
+static std::vector<float> render(const std::string &filename)
+{
+    RayTracingScene scene = RayTracingScene::FromScene(filename);
+    std::vector<float> pix(scene.getDims());
+    scene.getDistances(pix.data(), scene.getWidth());
+    return pix;
+}
+
+int main()
+{
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / ("ray-nbow-scene-test-" + std::to_string(getpid()));
+    std::filesystem::create_directories(dir);
+
+    int failures = 0;
+    auto check = [&](const bool &ok, const std::string &what)
+    {
+        if(!ok)
+        {
+            std::cerr << what << std::endl;
+            failures++;
+        }
+    };
+
+    for(const auto &c : TOKENS)
+    {
+        std::string file = (dir / "tokens.scene").string();
+        writeAll(file, c.text);
+        SceneTokenizer f;
+        check(f.open(file) && c.read(f), "tokenizer: " + c.name);
+    }
+
+    // a compiled scene renders the same as the scene it was compiled from.
+    std::string mesh = (dir / ("mesh" + std::string(TriangleMesh::BINARY_EXTENSION))).string();
+    TriangleMesh triangles;
+    triangles.addTriangle({-1, -1, 0}, {1, -1, 0}, {0, 1, 0});
+    triangles.addTriangle({-1, 1, 0.5f}, {1, 1, 0.5f}, {0, -1, 0.5f});
+    check(triangles.saveBinary(mesh), "compile: could not write the mesh");
+    std::string text = (dir / "a.scene").string(), compiled = (dir / ("a" + std::string(RayTracingScene::COMPILED_EXTENSION))).string();
+    writeAll(text, "width 32\nheight 24\nfov 60\naccel bvh\n"
+                   "sphere (0.5, 0, -2) 0.25\n"
+                   "triangle (-1, -1, -3) (1, -1, -3) (0, 1, -3)\n"
+                   "obj " + mesh + " (0, 0, -2.5) (0, 30, 0) (0.5, 0.5, 0.5)\n"
+                   "obj " + mesh + " (-0.5, 0, -2) (0, 0, 0) (0.25, 0.25, 0.25)\n");
+    check(RayTracingScene::Compile(text, compiled), "compile: failed");
+    std::vector<float> expected = render(text);
+    size_t hits = 0;
+    for(auto d : expected) hits += d > 0;
+    check(hits > 0 && render(compiled) == expected, "compile: the compiled scene renders differently");
+
+    // a loaded scene, already built, can change its thread count and be traced straight away.
+    RayTracingScene threaded = RayTracingScene::FromScene(text);
+    for(int threads : {3, 1, 0})
+    {
+        threaded.setThreads(threads);
+        std::vector<float> pix(threaded.getDims());
+        threaded.getDistances(pix.data(), threaded.getWidth());
+        check(pix == expected, "threads: " + std::to_string(threads) + " threads after loading render differently");
+    }
+
+    // a damaged compiled scene is rejected, leaving the empty default scene.
+    std::string bytes = readAll(compiled), copy = compiled + ".copy" + RayTracingScene::COMPILED_EXTENSION;
+    uint64_t names, records;
+    memcpy(&names, &bytes[16], sizeof(names));
+    memcpy(&records, &bytes[24], sizeof(records));
+    size_t meshSize = 40 + names + records * 48 + 8;
+    std::vector<std::pair<std::string, std::string>> damaged = {
+        {"empty", ""},
+        {"header only", bytes.substr(0, 40)},
+        {"truncated", bytes.substr(0, bytes.size() / 2)},
+        {"one byte short", bytes.substr(0, bytes.size() - 1)},
+        {"one byte long", bytes + 'x'},
+        {"bad magic", "X" + bytes.substr(1)},
+    };
+    for(auto offset : {size_t(16), size_t(24), size_t(32), meshSize})
+    {
+        uint64_t actual;
+        memcpy(&actual, &bytes[offset], sizeof(actual));
+        for(uint64_t count : {~0ull, (1ull << 62) + 1, actual + (1ull << 62)})
+        {
+            std::string bad = bytes;
+            memcpy(&bad[offset], &count, sizeof(count));
+            damaged.push_back({"count at " + std::to_string(offset), bad});
+        }
+    }
+    for(const auto &d : damaged)
+    {
+        writeAll(copy, d.second);
+        std::vector<float> pix = render(copy);
+        bool empty = true;
+        for(auto v : pix) empty = empty && v == 0;
+        check(empty, "compile: accepted a damaged scene (" + d.first + ")");
+    }
+
+    std::filesystem::remove_all(dir);
+    std::cout << (failures == 0 ? "passed" : "FAILED") << std::endl;
+    return failures == 0 ? 0 : 1;
+}